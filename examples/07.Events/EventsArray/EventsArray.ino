@@ -0,0 +1,42 @@
+/**
+ * EventsArray
+ *
+ * Demonstrates the use of a single event callback for an array of units.
+ *
+ * Each LED is toggled by its own metronome. Instead of writing one callback
+ * per LED, a single callback receives the LED to toggle as a pointer.
+ *
+ * The circuit:
+ * - Three LEDs.
+ * - The anode of the LEDs are connected in series with a 220-ohm resistor to pins 4, 5, and 6.
+ * - Their cathodes connect to ground.
+ *
+ * Created in 2025 by Sofian Audry
+ *
+ * This example code is in the public domain.
+ */
+#include <Plaquette.h>
+
+// The number of LEDs.
+const int N_LEDS = 3;
+
+// A metronome for each LED.
+Metronome metronomes[] = { 0.5, 1.0, 1.5 };
+
+// The array of LEDs.
+DigitalOut leds[] = { 4, 5, 6 };
+
+void begin() {
+  // Register the same callback on each metronome, with its LED as context.
+  for (int i=0; i<N_LEDS; i++) {
+    metronomes[i].onBang(toggleLed, &leds[i]);
+  }
+}
+
+void step() {
+}
+
+// Toggles the LED passed as context.
+void toggleLed(void* led) {
+  static_cast<DigitalOut*>(led)->toggle();
+}
@@ -0,0 +1,53 @@
+/**
+ * EnginesParentChild
+ *
+ * Demonstrates the use of child engines to run parts of a program at different paces.
+ * The primary engine runs at 1000 Hz and steps two child engines: a fast engine
+ * (stepped at every step, ie. 1000 Hz) that monitors interactions with a pushbutton,
+ * and a slow engine (stepped every 20 steps, ie. 50 Hz) that manages the blinking of
+ * an LED. Child engines take their time from the primary engine, so they stay exactly
+ * aligned with it without reading the clock themselves.
+ *
+ * The circuit:
+ * - LED attached from digital pin 13 to ground (*)
+ * - pushbutton attached to digital pin 2 from ground
+ * Note: on most Arduinos there is already an LED on the board
+ * attached to pin 13.
+ *
+ * Created in 2025 by Sofian Audry
+ *
+ * This example code is in the public domain.
+ */
+#include <Plaquette.h>
+
+// The child engines.
+Engine slowEngine;
+Engine fastEngine;
+
+// Button (operates on fast engine to monitor interactions).
+DigitalIn button(2, INTERNAL_PULLUP, fastEngine);
+
+// The square wave and LED (can operate more slowly to save on computation).
+Wave wave(1.0, slowEngine);
+DigitalOut led(LED_BUILTIN, slowEngine);
+
+void begin() {
+  // Run primary engine at 1000 Hz.
+  Plaquette.sampleRate(1000);
+
+  // Attach child engines (they are initialized and stepped by the primary engine).
+  Plaquette.addChild(fastEngine);     // 1000 Hz
+  Plaquette.addChild(slowEngine, 20); // 50 Hz
+
+  // Debounce button.
+  button.debounce();
+
+  // Connect wave to LED.
+  slowEngine.connect(wave, led);
+}
+
+void step() {
+  // On button press, increase square wave frequency.
+  if (button.rose())
+    wave.frequency(wave.frequency() + 1);
+}
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+#
+# decode_event_trace.py
+#
+# (c) 2025 Sofian Audry        :: info(@)sofianaudry(.)com
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+"""Decodes an event trace dumped by Engine::dumpEventTrace().
+
+Prints one CSV line per callback call with its latency, ie. the time between the
+beginning of the step at which the event occurred and the call:
+  time_us,step,unit,event,latency_us
+
+With --summary, prints latency statistics per unit and event type instead, as well
+as the largest number of callbacks called during a single step (event storms).
+
+Times are real times from the engine's reference clock (virtual clock and time scale
+are not applied). Units are identified by their position in the engine, which changes
+when units are removed: a trace spanning such a removal may mix up units.
+
+Usage: decode_event_trace.py [--summary] trace.bin
+"""
+
+import struct
+import sys
+
+HEADER = struct.Struct("<4sBBII")
+RECORD = struct.Struct("<IIHBB")
+
+RECORD_STEP = 0
+RECORD_DISPATCH = 1
+
+EVENT_NAMES = ["none", "change", "rise", "fall", "bang", "finish", "update"]
+
+
+def read_trace(data):
+    """Returns (records, number of overwritten records) where records are tuples
+    (time_us, step, unit, event_type, record_type), oldest first."""
+    magic, version, record_size, n_records, n_overwritten = HEADER.unpack_from(data, 0)
+    if magic != b"PQTR" or version != 1 or record_size != RECORD.size:
+        raise ValueError("not a Plaquette event trace (or unsupported version)")
+    records = [RECORD.unpack_from(data, HEADER.size + i * record_size) for i in range(n_records)]
+    return records, n_overwritten
+
+
+def dispatches(records):
+    """Yields (time_us, step, unit, event_type, latency_us) for each callback call.
+    Latency is None if the beginning of the step is not in the trace."""
+    step_times = {}
+    for time_us, step, unit, event_type, record_type in records:
+        if record_type == RECORD_STEP:
+            step_times[step] = time_us
+        elif record_type == RECORD_DISPATCH:
+            start = step_times.get(step)
+            latency = (time_us - start) & 0xFFFFFFFF if start is not None else None
+            yield time_us, step, unit, event_type, latency
+
+
+def event_name(event_type):
+    return EVENT_NAMES[event_type] if event_type < len(EVENT_NAMES) else str(event_type)
+
+
+def print_csv(records):
+    print("time_us,step,unit,event,latency_us")
+    for time_us, step, unit, event_type, latency in dispatches(records):
+        print("%d,%d,%d,%s,%s" % (time_us, step, unit, event_name(event_type),
+                                  "" if latency is None else latency))
+
+
+def print_summary(records, n_overwritten):
+    latencies = {}
+    calls_per_step = {}
+    for _, step, unit, event_type, latency in dispatches(records):
+        calls_per_step[step] = calls_per_step.get(step, 0) + 1
+        if latency is not None:
+            latencies.setdefault((unit, event_type), []).append(latency)
+
+    print("unit,event,n_calls,mean_latency_us,max_latency_us")
+    for (unit, event_type), values in sorted(latencies.items()):
+        print("%d,%s,%d,%.1f,%d" % (unit, event_name(event_type), len(values),
+                                     sum(values) / len(values), max(values)))
+
+    if calls_per_step:
+        step, n_calls = max(calls_per_step.items(), key=lambda item: item[1])
+        print("# max calls per step: %d (step %d)" % (n_calls, step))
+    print("# overwritten records: %d" % n_overwritten)
+
+
+def main(argv):
+    summary = "--summary" in argv
+    paths = [arg for arg in argv if arg != "--summary"]
+    if len(paths) != 1:
+        sys.exit(__doc__)
+    with open(paths[0], "rb") as f:
+        records, n_overwritten = read_trace(f.read())
+    if summary:
+        print_summary(records, n_overwritten)
+    else:
+        print_csv(records)
+
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
@@ -19,6 +19,7 @@
  */
 
 #include "AbstractChronometer.h"
+#include "StateArchive.h"
 
 namespace pq {
 
@@ -28,15 +29,15 @@ AbstractChronometer::AbstractChronometer()
 
 void AbstractChronometer::pause() {
   if (_isRunning) {
-    _offsetTime = elapsed(); // save current offset
-    _isRunning = false;
+    _elapsedTime = _offsetTime = elapsed(); // save current offset
+    _setRunning(false);
   }
 }
 
 void AbstractChronometer::resume() {
   if (!_isRunning) {
     _startTime = _time();
-    _isRunning = true;
+    _setRunning(true);
   }
 }
 
@@ -62,7 +63,13 @@ void AbstractChronometer::setTime(float time) {
 }
 
 void AbstractChronometer::addTime(float time) {
-  setTime(_elapsedTime + time);
+  setTime(elapsed() + time);
+}
+
+float AbstractChronometer::elapsed() const {
+  // Computed from current time while running so that it stays valid even if update() is not called
+  // at every step (eg. when unit is dormant).
+  return (_isRunning ? _offsetTime + (_time() - _startTime) : _elapsedTime);
 }
 
 void AbstractChronometer::update() {
@@ -75,4 +82,14 @@ void AbstractChronometer::update() {
   }
 }
 
+void AbstractChronometer::_serializeTime(StateArchive& archive) {
+  float elapsedTime = archive.copy(elapsed());
+  bool isRunning = archive.copy(_isRunning);
+  if (archive.isLoading()) {
+    // Restart from current time.
+    setTime(elapsedTime);
+    _setRunning(isRunning);
+  }
+}
+
 }
@@ -39,7 +39,7 @@ public:
   virtual void resume();
 
   /// The time currently elapsed by the chronometer (in seconds).
-  virtual float elapsed() const { return _elapsedTime; }
+  virtual float elapsed() const;
 
   /// Returns true iff elapsed time has passed given timeout.
   virtual bool hasPassed(float timeout) const;
@@ -75,6 +75,9 @@ protected:
   // Sets running state.
   virtual void _setRunning(bool isRunning) { _isRunning = isRunning; }
 
+  // Saves or loads elapsed time and running state (see Unit::serializeState()).
+  void _serializeTime(StateArchive& archive);
+
   // The starting time (in seconds).
   float _startTime;
 
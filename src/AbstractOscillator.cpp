@@ -19,6 +19,7 @@
  */
 
 #include "AbstractOscillator.h"
+#include "StateArchive.h"
 #include "pq_random32.h"
 #include "pq_map.h"
 #include "pq_time.h"
@@ -32,6 +33,7 @@ AbstractOscillator::AbstractOscillator(float period_)
 #if PQ_OPTIMIZE_FOR_CPU
   _frequency(FLT_MAX),
 #endif
+  _phaseIncrementMantissa(0), _phaseIncrementShift(0),
   _phaseShiftOrRandomFrequencyRatio(0),
   _overflowed(false), _isRunning(false), _isForward(true), _valueNeedsUpdate(true), _jitterLevel(0) {
   period(period_);
@@ -89,16 +91,16 @@ void AbstractOscillator::jitter(float jitterLevel) {
     _phaseShiftOrRandomFrequencyRatio = 0;
 }
 
-void AbstractOscillator::_stepPhase(float deltaTimeSecondsTimesFixed32Max) {
+void AbstractOscillator::_stepPhase(uint32_t deltaTimeMicroSeconds) {
 
   if (!isRunning()) {
     _overflowed = false;
   }
 
   else if (!_jitterLevel) {
-    // Deterministic path (unchanged)
-    _overflowed = phase32UpdateFixed32(_phase32, frequency(),
-                                       deltaTimeSecondsTimesFixed32Max, _isForward);
+    // Deterministic path: integer arithmetic only.
+    _overflowed = phase32UpdateMicros(_phase32, deltaTimeMicroSeconds,
+                                      _phaseIncrementMantissa, _phaseIncrementShift, _isForward);
   }
 
   // Running scheduled random path.
@@ -106,7 +108,7 @@ void AbstractOscillator::_stepPhase(float deltaTimeSecondsTimesFixed32Max) {
 
     // Advance phase using the instantaneous frequency for THIS interval
     _overflowed = phase32UpdateFixed32(_phase32, _phaseShiftOrRandomFrequencyRatio*frequency(),
-                                       deltaTimeSecondsTimesFixed32Max, _isForward);
+                                       microsToSecondsTimesFixed32Max(deltaTimeMicroSeconds), _isForward);
 
     // Overflowed: schedule next.
     if (_overflowed) {
@@ -125,9 +127,15 @@ void AbstractOscillator::period(float period) {
     // Assign frequency.
     _frequency = periodToFrequency(_period);
 #endif
+
+    _updatePhaseIncrement();
   }
 }
 
+void AbstractOscillator::_updatePhaseIncrement() {
+  frequencyToPhase32PerMicros(frequency(), _phaseIncrementMantissa, _phaseIncrementShift);
+}
+
 void AbstractOscillator::frequency(float frequency) {
 #if PQ_OPTIMIZE_FOR_CPU
   // Assign period.
@@ -136,6 +144,8 @@ void AbstractOscillator::frequency(float frequency) {
 
     // Assign period.
     _period = frequencyToPeriod(_frequency);
+
+    _updatePhaseIncrement();
   }
 #else
   period( frequencyToPeriod(frequency) );
@@ -187,4 +197,14 @@ void AbstractOscillator::_setRunning(bool isRunning)
   _isRunning = isRunning;
 }
 
+void AbstractOscillator::_serializePhase(StateArchive& archive) {
+  archive.value(_phase32);
+  _isForward = archive.copy((bool)_isForward);
+  bool isRunning = archive.copy((bool)_isRunning);
+  if (archive.isLoading()) {
+    _setRunning(isRunning);
+    _valueNeedsUpdate = true;
+  }
+}
+
 }
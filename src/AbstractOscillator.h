@@ -146,8 +146,11 @@ public:
   virtual void toggleReverse() { _isForward = !_isForward; }
 
 protected:
-  // Perform step with under
-  void _stepPhase(float deltaTimeSecondsTimesFixed32Max);
+  // Advances phase by time elapsed since last step (in microseconds).
+  void _stepPhase(uint32_t deltaTimeMicroSeconds);
+
+  // Updates phase increment after a change of frequency.
+  void _updatePhaseIncrement();
 
   // Sets phase time.
   virtual void _setPhase32(q0_32u_t phase32);
@@ -155,6 +158,9 @@ protected:
   // Sets running state.
   virtual void _setRunning(bool isRunning);
 
+  // Saves or loads phase and running state (see Unit::serializeState()).
+  void _serializePhase(StateArchive& archive);
+
   // Picks next random frequency multiplier (for randomized oscillation).
   void _randomPickNext();
 
@@ -166,6 +172,10 @@ protected:
   float _frequency;
 #endif
 
+  // Phase increment per microsecond as mantissa / 2^shift (see frequencyToPhase32PerMicros()).
+  uint32_t _phaseIncrementMantissa;
+  uint8_t _phaseIncrementShift;
+
   // Non-random mode: Phase shift (in % of period).
   // Random mode: random frequency ratio (in % of frequency).
   float _phaseShiftOrRandomFrequencyRatio;
@@ -19,6 +19,7 @@
  */
 
 #include "AbstractWave.h"
+#include "StateArchive.h"
 #include "pq_map.h"
 #include "pq_time.h"
 #include "pq_wrap.h"
@@ -50,10 +51,16 @@ void AbstractWave::begin() {
 
 void AbstractWave::step() {
   // Update phase time.
-  _stepPhase(engine()->deltaTimeSecondsTimesFixed32Max());
+  _stepPhase(deltaTimeMicroSeconds());
+  if (_overflowed)
+    _raiseEvent(EVENT_BANG);
 
   // Set flag to indicate value is out of sync.
   _valueNeedsUpdate = true;
+
+  // Phase will not change until restarted.
+  if (!isRunning())
+    _sleep();
 }
 
 float AbstractWave::_getAmplified(q0_32u_t t) {
@@ -74,6 +81,7 @@ float AbstractWave::atPhase(float phase) {
 
 void AbstractWave::amplitude(float amplitude)  {
   _amplitude = floatToFixed32(amplitude);
+  _valueNeedsUpdate = true;
 }
 
 void AbstractWave::skew(float skew) {
@@ -90,9 +98,15 @@ bool AbstractWave::eventTriggered(EventType eventType) {
   else return AnalogSource::eventTriggered(eventType);
 }
 
-// void AbstractWave::_setRunning(bool isRunning)
-// {
-//   _isRunning = isRunning;
-// }
+void AbstractWave::_setRunning(bool isRunning)
+{
+  AbstractOscillator::_setRunning(isRunning);
+  if (isRunning)
+    _wake();
+}
+
+void AbstractWave::serializeState(StateArchive& archive) {
+  _serializePhase(archive);
+}
 
 }
@@ -118,20 +118,30 @@ public:
   /// Registers event callback on wave end-of-period ("bang") event.
   virtual void onBang(EventCallback callback);
 
+  /// Registers event callback on wave end-of-period ("bang") event, called with a user pointer.
+  virtual void onBang(EventContextCallback callback, void* context) { onEvent(callback, context, EVENT_BANG); }
+
 protected:
   // Core Plaquette methods.
   virtual void begin();
   virtual void step();
+  virtual void serializeState(StateArchive& archive);
 
   // Returns true if event is triggered.
   virtual bool eventTriggered(EventType eventType);
 
+  // Bang events are raised by step().
+  virtual bool raisesEvent(EventType eventType) const { return (eventType == EVENT_BANG || AnalogSource::raisesEvent(eventType)); }
+
   // Returns value in [0, 1] as fixed32-point value (to be defined by subclasses).
   virtual q0_32u_t _getFixed32(q0_32u_t t) = 0;
 
   // Returns amplified version of _get(t).
   virtual float _getAmplified(q0_32u_t t);
 
+  // Sets running state.
+  virtual void _setRunning(bool isRunning);
+
   // Amplitude (in %).
   q0_32u_t _amplitude;
 
@@ -19,6 +19,7 @@
  */
 
 #include "Alarm.h"
+#include "StateArchive.h"
 
 namespace pq {
 
@@ -46,15 +47,37 @@ void Alarm::step() {
 
   // Update change state.
   _updateChangeState();
+  if (_changeState > 0)
+    _raiseEvent(EVENT_FINISH);
+
+  // Value will not change until restarted (or changed).
+  if ((!_isRunning || isFinished()) && !_changeState)
+    _sleep();
 }
 
 void Alarm::setTime(float time) {
   AbstractTimer::setTime(time);
   _onValue = isFinished();
+  _wake();
+}
+
+void Alarm::duration(float duration) {
+  AbstractTimer::duration(duration);
+  _wake();
 }
 
 float Alarm::_time() const {
   return Unit::seconds();
 }
 
+void Alarm::_setRunning(bool isRunning) {
+  AbstractTimer::_setRunning(isRunning);
+  if (isRunning)
+    _wake();
+}
+
+void Alarm::serializeState(StateArchive& archive) {
+  _serializeTime(archive);
+}
+
 }
@@ -50,12 +50,22 @@ public:
   /// Registers event callback on finish event.
   virtual void onFinish(EventCallback callback) { onEvent(callback, EVENT_FINISH); }
 
+  /// Registers event callback on finish event, called with a user pointer.
+  virtual void onFinish(EventContextCallback callback, void* context) { onEvent(callback, context, EVENT_FINISH); }
+
   /// Set alarm at specific time.
   virtual void setTime(float time);
 
+  /// Sets the duration of the alarm.
+  virtual void duration(float duration);
+
+  /// Returns duration.
+  virtual float duration() const { return AbstractTimer::duration(); }
+
 protected:
   virtual void begin();
   virtual void step();
+  virtual void serializeState(StateArchive& archive);
 
   /// Returns true iff an event of a certain type has been triggered.
   virtual bool eventTriggered(EventType eventType) {
@@ -65,8 +75,16 @@ protected:
     }
   }
 
+  /// Finish and change events are raised by step().
+  virtual bool raisesEvent(EventType eventType) const {
+    return (eventType == EVENT_FINISH || _isChangeEvent(eventType) || DigitalSource::raisesEvent(eventType));
+  }
+
   // Returns current absolute time (in seconds).
   virtual float _time() const;
+
+  // Sets running state.
+  virtual void _setRunning(bool isRunning);
 };
 
 }
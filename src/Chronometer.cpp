@@ -19,6 +19,7 @@
  */
 
 #include "Chronometer.h"
+#include "StateArchive.h"
 
 namespace pq {
 
@@ -36,10 +37,24 @@ void Chronometer::begin() {
 
 void Chronometer::step() {
   update();
+
+  // Elapsed time will not change until restarted.
+  if (!_isRunning)
+    _sleep();
 }
 
 float Chronometer::_time() const {
   return seconds();
 }
 
+void Chronometer::_setRunning(bool isRunning) {
+  AbstractChronometer::_setRunning(isRunning);
+  if (isRunning)
+    _wake();
+}
+
+void Chronometer::serializeState(StateArchive& archive) {
+  _serializeTime(archive);
+}
+
 }
@@ -39,9 +39,13 @@ public:
 protected:
   virtual void begin();
   virtual void step();
+  virtual void serializeState(StateArchive& archive);
 
   // Returns current absolute time (in seconds).
   virtual float _time() const;
+
+  // Sets running state.
+  virtual void _setRunning(bool isRunning);
 };
 
 }
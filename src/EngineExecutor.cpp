@@ -0,0 +1,206 @@
+/*
+ * EngineExecutor.cpp
+ *
+ * (c) 2025 Sofian Audry        :: info(@)sofianaudry(.)com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pq_globals.h"
+
+#if PQ_HAS_THREADS
+
+// NOTE: Standard headers need to be included before Plaquette headers which define min() and max() macros.
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "EngineExecutor.h"
+
+namespace pq {
+
+struct EngineExecutor::Impl {
+  // Task performed by workers during a round.
+  enum Task {
+    TASK_BEGIN,
+    TASK_STEP
+  };
+
+  // An engine and its step callback.
+  struct Entry {
+    Engine* engine;
+    EngineStepCallback callback;
+  };
+
+  // Registered engines.
+  std::vector<Entry> entries;
+
+  // Worker threads.
+  std::vector<std::thread> workers;
+
+  // Number of worker threads (set before workers are launched).
+  size_t nWorkers = 0;
+
+  // Synchronization.
+  std::mutex mutex;
+  std::unique_ptr<std::condition_variable[]> startConditions; // one per worker
+  std::condition_variable doneCondition;
+
+  // Current task.
+  Task task = TASK_STEP;
+
+  // Round counter (incremented to start a new round).
+  unsigned long round = 0;
+
+  // Number of workers taking part in current round (workers without engines are left asleep).
+  size_t nActiveWorkers = 0;
+
+  // Number of workers that have not yet completed current round.
+  size_t nPending = 0;
+
+  // Number of engines that performed a step during current round.
+  size_t nStepped = 0;
+
+  // True when workers need to exit.
+  bool stopping = false;
+
+  // Performs task on engines assigned to a worker (engines workerIndex, workerIndex + nWorkers, ...).
+  size_t perform(Task currentTask, size_t workerIndex, size_t nWorkers) {
+    size_t count = 0;
+    for (size_t i = workerIndex; i < entries.size(); i += nWorkers) {
+      Entry& entry = entries[i];
+      if (currentTask == TASK_BEGIN) {
+        entry.engine->begin();
+      }
+      else if (entry.engine->step()) {
+        count++;
+        if (entry.callback)
+          entry.callback(*entry.engine);
+      }
+    }
+    return count;
+  }
+
+  // Worker thread main loop.
+  void work(size_t workerIndex) {
+    unsigned long lastRound = 0;
+    for (;;) {
+      // Wait for next round.
+      Task currentTask;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        startConditions[workerIndex].wait(lock, [&] { return stopping || (round != lastRound && workerIndex < nActiveWorkers); });
+        if (stopping)
+          return;
+        lastRound = round;
+        currentTask = task;
+      }
+
+      // Process assigned engines.
+      size_t count = perform(currentTask, workerIndex, nWorkers);
+
+      // Signal completion.
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        nStepped += count;
+        if (--nPending == 0)
+          doneCondition.notify_one();
+      }
+    }
+  }
+
+  // Runs a round and waits for all workers to complete it.
+  size_t run(Task newTask) {
+    // No workers (stopped): run on calling thread.
+    if (workers.empty())
+      return perform(newTask, 0, 1);
+
+    // Only wake workers that have engines assigned (worker i steps engines i, i + nWorkers, ...).
+    size_t nActive = (entries.size() < nWorkers ? entries.size() : nWorkers);
+    if (nActive == 0)
+      return 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    task = newTask;
+    nActiveWorkers = nPending = nActive;
+    nStepped = 0;
+    round++;
+    for (size_t i = 0; i < nActive; i++)
+      startConditions[i].notify_one();
+    doneCondition.wait(lock, [&] { return nPending == 0; });
+    return nStepped;
+  }
+};
+
+EngineExecutor::EngineExecutor(size_t nThreads) : _impl(new Impl) {
+  if (nThreads == 0)
+    nThreads = std::thread::hardware_concurrency();
+  if (nThreads == 0)
+    nThreads = 1;
+
+  // Launch workers.
+  _impl->nWorkers = nThreads;
+  _impl->startConditions.reset(new std::condition_variable[nThreads]);
+  _impl->workers.reserve(nThreads);
+  for (size_t i = 0; i < nThreads; i++)
+    _impl->workers.push_back(std::thread(&Impl::work, _impl, i));
+}
+
+EngineExecutor::~EngineExecutor() {
+  end();
+  delete _impl;
+}
+
+void EngineExecutor::add(Engine& engine, EngineStepCallback callback) {
+  Impl::Entry entry = { &engine, callback };
+  _impl->entries.push_back(entry);
+}
+
+size_t EngineExecutor::nEngines() const {
+  return _impl->entries.size();
+}
+
+size_t EngineExecutor::nThreads() const {
+  return _impl->workers.size();
+}
+
+void EngineExecutor::begin() {
+  _impl->run(Impl::TASK_BEGIN);
+}
+
+size_t EngineExecutor::step() {
+  return _impl->run(Impl::TASK_STEP);
+}
+
+void EngineExecutor::end() {
+  // Signal workers to exit.
+  {
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    _impl->stopping = true;
+  }
+  for (size_t i = 0; i < _impl->workers.size(); i++)
+    _impl->startConditions[i].notify_one();
+
+  // Wait for workers to exit.
+  for (size_t i = 0; i < _impl->workers.size(); i++)
+    _impl->workers[i].join();
+  _impl->workers.clear();
+  _impl->nWorkers = 0;
+}
+
+} // namespace pq
+
+#endif
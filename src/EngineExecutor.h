@@ -0,0 +1,93 @@
+/*
+ * EngineExecutor.h
+ *
+ * (c) 2025 Sofian Audry        :: info(@)sofianaudry(.)com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PQ_ENGINE_EXECUTOR_H_
+#define PQ_ENGINE_EXECUTOR_H_
+
+#include "PqCore.h"
+
+#if PQ_HAS_THREADS
+
+namespace pq {
+
+/// Callback called after an engine has completed a step.
+typedef void (*EngineStepCallback)(Engine& engine);
+
+/**
+ * Steps a set of independent engines in parallel on a pool of worker threads (host builds only).
+ *
+ * Each call to step() performs one round: every engine's step() is called exactly once,
+ * and step() returns once all engines are done. Each engine keeps its own clock and sample rate
+ * and is always stepped by the same worker, in the order engines were added, so that the sequence
+ * of steps of a given engine is the same as when running on a single thread.
+ *
+ * Engines (and their units) must not share state: units of different engines can run concurrently.
+ * Global services such as the console and random functions are not thread-safe.
+ */
+class EngineExecutor {
+public:
+  /**
+   * Constructor.
+   * @param nThreads number of worker threads (0: number of hardware threads)
+   */
+  EngineExecutor(size_t nThreads = 0);
+
+  /// Destructor. Stops and joins all worker threads.
+  ~EngineExecutor();
+
+  /**
+   * Adds an engine. Must not be called during a step.
+   * @param engine the engine
+   * @param callback optional function called (on the worker thread) after each completed step of the engine
+   */
+  void add(Engine& engine, EngineStepCallback callback = 0);
+
+  /// Returns number of engines.
+  size_t nEngines() const;
+
+  /// Returns number of worker threads.
+  size_t nThreads() const;
+
+  /// Calls begin() on all engines (in parallel).
+  void begin();
+
+  /**
+   * Calls step() on all engines in parallel and waits for completion.
+   * @return the number of engines that performed a step (see Engine::step())
+   */
+  size_t step();
+
+  /// Stops and joins all worker threads. Called automatically by destructor.
+  void end();
+
+private:
+  // Internal implementation (keeps threading headers out of Plaquette headers).
+  struct Impl;
+  Impl* _impl;
+
+  // Prevent copy-construction and assignment.
+  EngineExecutor(const EngineExecutor&);
+  EngineExecutor& operator=(const EngineExecutor&);
+};
+
+} // namespace pq
+
+#endif
+
+#endif
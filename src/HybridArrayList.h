@@ -102,8 +102,10 @@ public:
                 }
                 // Add item.
                 _staticArray[index] = item;
-                // Now insert temp into the first position of dynamic array, shifting others.
+                // Now insert temp into the first position of dynamic array, shifting others
+                // (this also increases size).
                 insert(STATIC_CAPACITY, temp);
+                return;
             }
         }
         // Inserting within the dynamic array.
@@ -196,6 +198,31 @@ public:
         // Optional: Shrink dynamic array if too much unused space
     }
 
+    /**
+     * Removes all elements for which a predicate returns true, in a single pass over the list.
+     * Remaining elements keep their order.
+     * 
+     * @param predicate Function or function object taking an element and returning true if it should be removed.
+     * @return The number of elements removed.
+     */
+    template<typename Predicate>
+    size_t removeIf(Predicate predicate) {
+        size_t newSize = 0;
+        for (size_t i = 0; i < _size; i++) {
+            T& item = _at(i);
+            if (!predicate(item)) {
+                // Move kept item to its new position.
+                if (newSize != i) {
+                    _at(newSize) = item;
+                }
+                newSize++;
+            }
+        }
+        size_t nRemoved = _size - newSize;
+        _size = newSize;
+        return nRemoved;
+    }
+
     // Operator[] for element access, behaving like get()
     T& operator[](int index) {
         index = constrain(index, 0, (int)_size - 1);
@@ -217,6 +244,17 @@ public:
         return this->operator[](index);
     }
 
+    /**
+     * Shrinks the list to its first elements without changing its capacity.
+     * 
+     * @param size The new size (ignored if greater than current size).
+     */
+    void truncate(size_t size) {
+        if (size < _size) {
+            _size = size;
+        }
+    }
+
     /**
      * Removes all items from the list without changing its capacity.
     */
@@ -240,6 +278,13 @@ private:
     size_t _size; ///< The current number of elements.
     size_t _dynamicCapacity; ///< The current capacity of the dynamic array.
 
+    /**
+     * Returns element at the specified position (without bounds checking).
+     */
+    T& _at(size_t index) {
+        return index < STATIC_CAPACITY ? _staticArray[index] : _dynamicArray[index - STATIC_CAPACITY];
+    }
+
     /**
      * Ensures there is enough capacity for new elements, resizing the dynamic array if necessary.
      */
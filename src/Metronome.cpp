@@ -19,6 +19,7 @@
  */
 
 #include "Metronome.h"
+#include "StateArchive.h"
 #include "pq_wrap.h"
 
 namespace pq {
@@ -32,7 +33,13 @@ void Metronome::begin() {
 
 void Metronome::step() {
   // Adjust phase time.
-  _stepPhase(engine()->deltaTimeSecondsTimesFixed32Max());
+  _stepPhase(deltaTimeMicroSeconds());
+  if (_overflowed)
+    _raiseEvent(EVENT_BANG);
+
+  // Will not fire until restarted.
+  if (!isRunning())
+    _sleep();
 }
 
 void Metronome::onBang(EventCallback callback) {
@@ -44,4 +51,14 @@ bool Metronome::eventTriggered(EventType eventType) {
   else return DigitalUnit::eventTriggered(eventType);
 }
 
+void Metronome::_setRunning(bool isRunning) {
+  AbstractOscillator::_setRunning(isRunning);
+  if (isRunning)
+    _wake();
+}
+
+void Metronome::serializeState(StateArchive& archive) {
+  _serializePhase(archive);
+}
+
 }
@@ -51,13 +51,23 @@ public:
   /// Registers event callback on metronome tick ("bang") event.
   virtual void onBang(EventCallback callback);
 
+  /// Registers event callback on metronome tick ("bang") event, called with a user pointer.
+  virtual void onBang(EventContextCallback callback, void* context) { onEvent(callback, context, EVENT_BANG); }
+
 protected:
   // Core Plaquette methods.
   virtual void begin();
   virtual void step();
+  virtual void serializeState(StateArchive& archive);
 
   // Returns true if event is triggered.
   virtual bool eventTriggered(EventType eventType);
+
+  // Bang events are raised by step().
+  virtual bool raisesEvent(EventType eventType) const { return (eventType == EVENT_BANG || DigitalUnit::raisesEvent(eventType)); }
+
+  // Sets running state.
+  virtual void _setRunning(bool isRunning);
 };
 
 /// @deprecated
@@ -19,6 +19,7 @@
  */
 
 #include "MinMaxScaler.h"
+#include "StateArchive.h"
 
 #include "float.h"
 #include "pq_map.h"
@@ -164,16 +165,26 @@ void MinMaxScaler::step() {
 
 float MinMaxScaler::_alphaMinMax() const {
   float minMaxTimeWindow = max(_timeWindow - _smoothedTimeWindow(true), 0);
-  return movingAverageAlpha(sampleRate(), minMaxTimeWindow);
+  _minMaxAlpha.update(*this, minMaxTimeWindow);
+  return _minMaxAlpha.alpha();
 }
 
 float MinMaxScaler::_alphaSmoothed(bool finiteTimeWindow) const {
-  return movingAverageAlpha(sampleRate(), _smoothedTimeWindow(finiteTimeWindow), _nSamples);
+  _smoothedAlpha.update(*this, _smoothedTimeWindow(finiteTimeWindow));
+  return _smoothedAlpha.alpha(_nSamples);
 }
 
 float MinMaxScaler::_smoothedTimeWindow(bool finiteTimeWindow) const {
   return finiteTimeWindow ? min(SMOOTHED_MIN_MAX_TIME_PROPORTION*_timeWindow, SMOOTHED_MIN_MAX_MAXIMUM_TIME_WINDOW) : SMOOTHED_MIN_MAX_MAXIMUM_TIME_WINDOW;
 }
 
+void MinMaxScaler::serializeState(StateArchive& archive) {
+  MovingFilter::serializeState(archive);
+  archive.value(_minValue);
+  archive.value(_maxValue);
+  archive.value(_smoothedMinValue);
+  archive.value(_smoothedMaxValue);
+}
+
 }
 
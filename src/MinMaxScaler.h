@@ -72,6 +72,7 @@ public:
 
 public:
   virtual void step();
+  virtual void serializeState(StateArchive& archive);
 
   // Minimum value ever put (decays over time if time window is finite).
   float _minValue;
@@ -90,6 +91,10 @@ private:
   float _alphaMinMax() const;
   float _alphaSmoothed(bool finiteTimeWindow) const;
   float _smoothedTimeWindow(bool finiteTimeWindow) const;
+
+  // Precomputed terms of alpha values (updated when sample rate or time windows change).
+  mutable MovingAverageAlpha _minMaxAlpha;
+  mutable MovingAverageAlpha _smoothedAlpha;
 };
 
 }
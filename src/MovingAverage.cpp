@@ -24,6 +24,7 @@
  */
 
 #include "MovingAverage.h"
+#include "StateArchive.h"
 
 namespace pq {
 
@@ -51,4 +52,8 @@ float MovingAverage::delta(float d) {
   return applyMovingAverageDelta(_value, d);
 }
 
+void MovingAverage::serializeState(StateArchive& archive) {
+  archive.value(_value);
+}
+
 } // namespace pq
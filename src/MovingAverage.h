@@ -56,6 +56,9 @@ public:
   float get() { return _value; }
   float constGet() const { return _value; }
 
+  /// Saves or loads the value of the moving average (see Unit::serializeState()).
+  void serializeState(StateArchive& archive);
+
 protected:
   // The current value of the exponential moving average.
   float _value;
@@ -18,6 +18,7 @@
  */
 
 #include "MovingFilter.h"
+#include "StateArchive.h"
 
 namespace pq {
 
@@ -75,4 +76,12 @@ void MovingFilter::begin() {
   reset();
 }
 
+void MovingFilter::serializeState(StateArchive& archive) {
+  _isCalibrating    = archive.copy((bool)_isCalibrating);
+  _isPreInitialized = archive.copy((bool)_isPreInitialized);
+  _nValuesStep      = archive.copy((uint8_t)_nValuesStep);
+  archive.value(_nSamples);
+  archive.value(_value);
+}
+
 }
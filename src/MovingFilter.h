@@ -92,12 +92,17 @@ public:
 
 protected:
   virtual void begin();
+  virtual void serializeState(StateArchive& archive);
 
   // Returns the instantaneous moving average alpha for this filter.
   virtual float alpha() const {
-    return movingAverageAlpha(sampleRate(), timeWindow(), nSamples(), isPreInitialized());
+    _movingAverageAlpha.update(*this, timeWindow());
+    return _movingAverageAlpha.alpha(nSamples(), isPreInitialized());
   }
 
+  // Precomputed terms of alpha (updated when sample rate or time window change).
+  mutable MovingAverageAlpha _movingAverageAlpha;
+
   // Start/stop calibration flag.
   bool    _isCalibrating    : 1;
   bool    _isPreInitialized : 1;
@@ -19,6 +19,7 @@
  */
 
 #include "Normalizer.h"
+#include "StateArchive.h"
 #include "MovingStats.h"
 #include "pq_moving_average.h"
 
@@ -188,4 +189,12 @@ float Normalizer::mapTo(float toLow, float toHigh) {
   return mapFloat(get() - _targetMean, -absStdDevOutlier, absStdDevOutlier, toLow, toHigh);
 }
 
+void Normalizer::serializeState(StateArchive& archive) {
+  MovingFilter::serializeState(archive);
+  _mean.serializeState(archive);
+  _mean2.serializeState(archive);
+  archive.value(_currentMeanStep);
+  archive.value(_currentMean2Step);
+}
+
 }
@@ -146,6 +146,7 @@ public:
 
 protected:
   virtual void step();
+  virtual void serializeState(StateArchive& archive);
 
   // Helper function for constructors.
   void _init(float mean, float stdDev);
@@ -109,6 +109,9 @@ public:
   /// Registers event callback on peak detection.
   virtual void onBang(EventCallback callback);
 
+  /// Registers event callback on peak detection, called with a user pointer.
+  virtual void onBang(EventContextCallback callback, void* context) { onEvent(callback, context, EVENT_BANG); }
+
 protected:
   // Resets peak detection flags.
   void _reset();
@@ -18,13 +18,37 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "PqCore.h"
+#include "StateArchive.h"
 #include <float.h>
 
+#if defined(EPOXY_DUINO)
+#include <time.h>
+#endif
+
 namespace pq {
 
-HybridArrayList<Unit*, PLAQUETTE_MAX_UNITS>& Engine::units() {
-  static HybridArrayList<Unit*, PLAQUETTE_MAX_UNITS> instance;
-  return instance;
+#if defined(EPOXY_DUINO)
+// Default wait function on host: sleeps instead of busy polling.
+static void hostWaitMicroSeconds(uint32_t microSeconds) {
+  struct timespec duration;
+  duration.tv_sec  = microSeconds / MICROS_PER_SECOND;
+  duration.tv_nsec = (microSeconds % MICROS_PER_SECOND) * 1000L;
+#if defined(__linux__)
+  clock_nanosleep(CLOCK_MONOTONIC, 0, &duration, NULL);
+#else
+  nanosleep(&duration, NULL);
+#endif
+}
+#endif
+
+// Time scale of one in 16.16 fixed point.
+#define TIME_SCALE_FIXED16_ONE 65536UL
+
+// Splits a period in microseconds into whole microseconds and a fraction of microsecond (in 1/2^32 microseconds).
+static void splitMicroSeconds(float microSeconds, uint32_t& whole, uint32_t& fraction) {
+  whole = static_cast<uint32_t>(microSeconds);
+  float scaledFraction = (microSeconds - whole) * 4294967296.0f;
+  fraction = (scaledFraction < 4294967295.0f ? static_cast<uint32_t>(scaledFraction) : UINT32_MAX);
 }
 
 Engine& Engine::primary() {
@@ -35,22 +59,55 @@ Engine& Engine::primary() {
 Engine& Plaquette = Engine::primary();
 
 Engine::Engine()
-  : _unitsBeginIndex(0), _unitsEndIndex(0),
+  : _stepUnitsFunction(0), _units(), _nRemovedUnits(0), _activeUnits(), _activeUnitsDirty(false), _connections(), _nRemovedConnections(0),
+    _children(), _parent(0), _stepBudgetMicroSeconds(0), _nDeferredSteps(0), _deferredStep(false),
     _sampleRate(0.0f), _samplePeriod(0.0f), _targetSampleRate(0.0f),
     _microSeconds{},
     _targetTime{}, _stepState(STEP_INIT),
     _deltaTimeMicroSeconds(0),
     _deltaTimeSecondsTimesFixed32Max(0.0f),
+    _smoothedDeltaTimeMicroSeconds(0), _stableDeltaTimeMicroSeconds(0), _sampleRateVersion(0),
+    _targetDeltaTimeFraction(0), _targetTimeFraction(0),
+    _virtualDeltaTimeMicroSeconds(0), _virtualDeltaTimeFraction(0), _virtualTimeFraction(0),
+    _maxCatchUpSteps(0), _catchUpCount(0), _nCatchUpSteps(0),
     _nSteps(0),
     _autoSampleRate(true),
     _beginCompleted(false),
     _firstRun(true),
     _eventManager(),
     _totalGlobalMicroSeconds({0}),
-    _clockFunction(0)
+    _clockFunction(0), _clockFunction64(0), _clockTicksPerSecond(MICROS_PER_SECOND),
+    _realMicroSeconds{}, _timeScale(1), _timeScaleFixed16(TIME_SCALE_FIXED16_ONE),
+    _timeScaleOriginMicroSeconds(0), _timeScaleRealOriginMicroSeconds(0),
+#if defined(EPOXY_DUINO)
+    _waitFunction(hostWaitMicroSeconds)
+#else
+    _waitFunction(0)
+#endif
+#if PQ_TIMING_STATS
+  , _nOverruns(0), _maxLatenessMicroSeconds(0), _jitterProfile(), _overrunCallback(0)
+#endif
 {}
 
 Engine::~Engine() {
+  // Detach remaining units so that they do not try to deregister from a destroyed engine.
+  for (size_t i = 0; i != _units.size(); i++) {
+    if (_units[i])
+      _units[i]->_engine = 0;
+  }
+
+  // Detach from parent and children.
+  if (_parent)
+    _parent->_detachChild(this);
+  for (size_t i = 0; i != _children.size(); i++) {
+    Engine* child = _children[i].engine;
+    child->_parent = 0;
+
+    // Time of parent cannot be reconciled with reference clock: restart from it.
+    child->_restartClock();
+    if (child->_beginCompleted)
+      child->begin();
+  }
 }
 
 void Engine::preBegin() {
@@ -65,16 +122,36 @@ void Engine::preBegin() {
   _stepState = STEP_INIT;
   _deltaTimeMicroSeconds = 0;
   _deltaTimeSecondsTimesFixed32Max = 0;
+  _setStableDeltaTime(0); // unknown until first step
   _nSteps = 0;
+  _catchUpCount = 0;
+  _nCatchUpSteps = 0;
+  _nDeferredSteps = 0;
+  _deferredStep = false;
   _autoSampleRate = true;
   _firstRun = true;
 
-  _setSampleRate(FLT_MAX);
-
-  // Initialize all components.
-  for (size_t i = _unitsBeginIndex; i != _unitsEndIndex; i++) {
-    units()[i]->begin();
+#if PQ_TIMING_STATS
+  resetTimingStats();
+#endif
+
+  // Reclaim slots of removed units and connections.
+  if (_nRemovedUnits)
+    _compactUnits();
+  if (_nRemovedConnections)
+    _compactConnections();
+
+  // Initialize all components (waking them up).
+  for (size_t i = 0; i != _units.size(); i++) {
+    _units[i]->_dormant = false;
+    _units[i]->_deferred = false;
+    _units[i]->begin();
   }
+  _activeUnitsDirty = true;
+
+  // Initialize child engines.
+  for (size_t i = 0; i != _children.size(); i++)
+    _children[i].engine->begin();
 
   // Units have been initialized.
   _beginCompleted = true;
@@ -83,10 +160,56 @@ void Engine::preBegin() {
 void Engine::postBegin() {
   // Start timer.
   _microSeconds.micros64 = microSeconds(false);
+  _targetTime = _microSeconds;
+  _stepState = STEP_INIT;
   // Trick: by setting _nSteps = LONG_MAX, timeStep() will do _nStep++ which will overflow to 0
   _nSteps = ULONG_MAX;
+
+  // Restart time of decimated units (they will step on first step).
+  for (size_t i = 0; i != _units.size(); i++) {
+    Unit* unit = _units[i];
+    if (unit && unit->_decimation != 1)
+      unit->_restartDecimation();
+  }
+
+  // Start child engines (they will step on first step).
+  for (size_t i = 0; i != _children.size(); i++) {
+    Child& child = _children[i];
+    child.counter = 0;
+    child.engine->step(); // first step of child does its post-begin
+  }
+}
+
+
+void Engine::stepBlocking() {
+  while (!step())
+    _waitUntilNextStep();
+}
+
+void Engine::_waitUntilNextStep() {
+  uint32_t waitTime = microSecondsUntilNextStep();
+  if (waitTime && _waitFunction)
+    _waitFunction(waitTime);
 }
 
+uint32_t Engine::microSecondsUntilNextStep() {
+  if (_autoSampleRate || _virtualDeltaTimeMicroSeconds)
+    return 0;
+
+  // Find target time.
+  uint64_t targetTime = (_stepState == STEP_INIT ? _nextTargetTime() : _targetTime).micros64;
+  uint64_t currentTime = _updateGlobalMicroSeconds().micros64;
+
+  // Compute remaining time.
+  if (currentTime >= targetTime)
+    return 0;
+
+  // Convert to real time.
+  uint64_t remainingTime = targetTime - currentTime;
+  if (_timeScaleFixed16 != TIME_SCALE_FIXED16_ONE && !_parent)
+    remainingTime = ((remainingTime << 16) + _timeScaleFixed16 - 1) / _timeScaleFixed16; // round up
+  return (uint32_t)min(remainingTime, (uint64_t)UINT32_MAX);
+}
 
 void Engine::end() {
   if (_firstRun) {
@@ -110,82 +233,398 @@ uint64_t Engine::microSeconds(bool referenceTime) const {
 }
 
 void Engine::add(Unit* component) {
-  HybridArrayList<Unit*, PLAQUETTE_MAX_UNITS>& allUnits = units();
   if (component->engine()) {
     return; // XXX does not support moving components between engines
   }
 
-  // Find the right place to insert the component.
+  // Append component to this engine's units.
+  component->_engineIndex = _units.size();
+  _units.add(component);
+  _activeUnitsDirty = true;
+
+  // Assign parent engine.
+  component->_engine = this;
+
+  // Initialize component if needed.
+  if (_beginCompleted)
+    component->begin();
+}
+
+void Engine::remove(Unit* component) {
+  if (component->engine() != this) {
+    return;
+  }
+
+  // Empty the component's slot: the list itself is compacted on next step, which
+  // keeps removal constant-time and safe to call while units are being stepped.
+  _units[component->_engineIndex] = 0;
+  _nRemovedUnits++;
+
+  // Empty the slots of the component's connections.
+  for (size_t i = 0; i != _connections.size(); i++) {
+    Connection& connection = _connections[i];
+    if (connection.source == component || connection.sink == component) {
+      connection.source = connection.sink = 0;
+      _nRemovedConnections++;
+    }
+  }
+
+  // Detach component.
+  component->_engine = 0;
+}
+
+void Engine::_compactUnits() {
+  // Shift remaining units to fill empty slots, preserving order.
+  size_t n = 0;
+  for (size_t i = 0; i != _units.size(); i++) {
+    Unit* unit = _units[i];
+    if (unit) {
+      unit->_engineIndex = n;
+      _units[n++] = unit;
+    }
+  }
+
+  // Drop the tail.
+  _units.truncate(n);
+  _nRemovedUnits = 0;
+
+  // Positions have changed.
+  _activeUnitsDirty = true;
+}
 
-  // If there are already units, insert it after the last unit. Singleton always
-  // adds units in the first part of the array list for efficency.
-  if (nUnits() > 0 || isPrimary()) {
-    // Insert component.
-    if (_unitsEndIndex == allUnits.size()) {
-      allUnits.add(component);
-      _unitsEndIndex++;
+void Engine::_updateActiveUnits() {
+  _activeUnits.removeAll();
+  for (size_t i = 0; i != _units.size(); i++) {
+    Unit* unit = _units[i];
+    if (unit && !unit->_dormant) {
+      // Insert by priority (stable with respect to order of registration).
+      size_t j = _activeUnits.size();
+      _activeUnits.add(static_cast<uint16_t>(i));
+      while (j > 0 && _units[_activeUnits[j-1]]->_priority > unit->_priority) {
+        _activeUnits[j] = _activeUnits[j-1];
+        j--;
+      }
+      _activeUnits[j] = static_cast<uint16_t>(i);
     }
-    else {
-      allUnits.insert(_unitsEndIndex++, component);
-      // Shift indices of next engines in the array.
-      for (size_t i=_unitsEndIndex; i<allUnits.size(); ) {
-        Engine* engine = allUnits[i]->engine();
-        ++engine->_unitsBeginIndex;
-        i = ++engine->_unitsEndIndex;
+  }
+  _activeUnitsDirty = false;
+}
+
+bool Engine::connect(Unit& source, Unit& sink) {
+  if (source.engine() != this || sink.engine() != this || &source == &sink)
+    return false;
+
+  // Already connected.
+  for (size_t i = 0; i != _connections.size(); i++) {
+    if (_connections[i].source == &source && _connections[i].sink == &sink)
+      return true;
+  }
+
+  // Add connection and find its place in the schedule.
+  Connection connection = { &source, &sink, 0 };
+  _connections.add(connection);
+  if (!_sortConnections()) {
+    // The connection closes a cycle: cancel it.
+    for (size_t i = 0; i != _connections.size(); i++) {
+      if (_connections[i].source == &source && _connections[i].sink == &sink) {
+        _connections.remove(i);
+        break;
       }
     }
+    return false;
   }
 
-  // If there are no units yet, insert it at the end.
-  else {
-    allUnits.add(component);
-    _unitsBeginIndex = allUnits.size() - 1;
-    _unitsEndIndex = _unitsBeginIndex + 1;
+  return true;
+}
+
+// Header of saved state: magic number and format version.
+static const uint8_t STATE_HEADER[] = { 'P', 'Q', 'S', 1 };
+
+bool Engine::saveState(StateWriter& writer) {
+  uint8_t header[sizeof(STATE_HEADER)] = {};
+  memcpy(header, STATE_HEADER, sizeof(header));
+  writer.transfer(header, sizeof(header));
+
+  uint16_t n = nUnits();
+  writer.value(n);
+
+  // Save each unit preceded by the size of its state.
+  for (size_t i = 0; i != _units.size(); i++) {
+    Unit* unit = _units[i];
+    if (unit) {
+      StateSizeCounter counter;
+      unit->serializeState(counter);
+      uint16_t size = counter.size();
+      writer.value(size);
+      unit->serializeState(writer);
+    }
   }
 
-  // Assign parent engine.
-  component->_engine = this;
+  return writer.ok();
+}
 
-  // Initialize component if needed.
-  if (_beginCompleted)
-    component->begin();
+bool Engine::loadState(StateReader& reader) {
+  uint8_t header[sizeof(STATE_HEADER)] = {};
+  if (!reader.transfer(header, sizeof(header)) || memcmp(header, STATE_HEADER, sizeof(header)) != 0)
+    return false;
+
+  // Units need to match saved state.
+  uint16_t n;
+  if (!reader.value(n) || n != nUnits())
+    return false;
+
+  for (size_t i = 0; i != _units.size() && reader.ok(); i++) {
+    Unit* unit = _units[i];
+    if (unit) {
+      uint16_t size = 0;
+      reader.value(size);
+
+      // Only restore units whose state has the expected size.
+      StateSizeCounter counter;
+      unit->serializeState(counter);
+      if (size == counter.size())
+        unit->serializeState(reader);
+      else
+        reader.skip(size);
+
+      // Unit might need to be stepped again.
+      unit->_dormant = false;
+    }
+  }
+  _activeUnitsDirty = true;
+
+  return reader.ok();
+}
+
+bool Engine::addChild(Engine& child, uint16_t divider) {
+  // Refuse cycles.
+  for (Engine* ancestor = this; ancestor; ancestor = ancestor->_parent) {
+    if (ancestor == &child)
+      return false;
+  }
 
-  // if (component->engine != this) {
-  //   // Remove component from old engine.
-  //   if (component->engine)
-  //     component->engine->remove(component);
+  // Detach from previous parent.
+  if (child._parent)
+    child._parent->_detachChild(&child);
 
-  //   // Append component to new engine.
-  //   _units.add(component);
-  //   // Assign new engine.
-  //   component->engine = this;
-  // }
+  // Add child: from now on, its time follows this engine.
+  Child entry = { &child, max(divider, (uint16_t)1), 0 };
+  _children.add(entry);
+  child._parent = this;
+  child._totalGlobalMicroSeconds = _microSeconds;
+  if (_beginCompleted || child._beginCompleted)
+    child.begin();
 
-  // // Initialize component if needed.
-  // if (_beginCompleted)
-  //   component->begin();
+  // Parent already started: do the post-begin of child now so that it steps on next step of parent.
+  if (_beginCompleted && !_firstRun)
+    child.step();
+
+  return true;
 }
 
-void Engine::remove(Unit* component) {
-  // Remove component from list.
-  units().removeItem(component);
+bool Engine::removeChild(Engine& child) {
+  if (!_detachChild(&child))
+    return false;
+
+  // Time of parent cannot be reconciled with reference clock: restart from it.
+  child._restartClock();
+  if (child._beginCompleted)
+    child.begin();
+
+  return true;
+}
+
+bool Engine::_detachChild(Engine* child) {
+  for (size_t i = 0; i != _children.size(); i++) {
+    if (_children[i].engine == child) {
+      _children.remove(i);
+      child->_parent = 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Engine::_stepChildren() {
+  for (size_t i = 0; i != _children.size(); i++) {
+    Child& child = _children[i];
+    if (child.counter == 0) {
+      child.counter = child.divider - 1;
+      child.engine->step();
+    }
+    else
+      child.counter--;
+  }
+}
+
+bool Engine::disconnect(Unit& source, Unit& sink) {
+  for (size_t i = 0; i != _connections.size(); i++) {
+    Connection& connection = _connections[i];
+    if (connection.source == &source && connection.sink == &sink) {
+      // Empty slot: the list itself is compacted on next step (order is preserved).
+      connection.source = connection.sink = 0;
+      _nRemovedConnections++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Engine::_compactConnections() {
+  // Shift remaining connections to fill empty slots, preserving order.
+  size_t n = 0;
+  for (size_t i = 0; i != _connections.size(); i++) {
+    if (_connections[i].source)
+      _connections[n++] = _connections[i];
+  }
+
+  // Drop the tail.
+  _connections.truncate(n);
+  _nRemovedConnections = 0;
+}
+
+bool Engine::_sortConnections() {
+  // Depth of each unit in the data flow graph (indexed by position in engine).
+  HybridArrayList<size_t, PLAQUETTE_MAX_UNITS> depths;
+  for (size_t i = 0; i != _units.size(); i++)
+    depths.add(0);
+
+  // Compute depths as longest paths by relaxation. In an acyclic graph this needs at most
+  // one pass per unit: if depths are still changing after that, there is a cycle.
+  size_t nPasses = 0;
+  bool changed = true;
+  while (changed) {
+    if (nPasses++ > _units.size())
+      return false;
+
+    changed = false;
+    for (size_t i = 0; i != _connections.size(); i++) {
+      Connection& connection = _connections[i];
+      if (!connection.source)
+        continue;
+      size_t depth = depths[connection.source->_engineIndex] + 1;
+      if (depth > depths[connection.sink->_engineIndex]) {
+        depths[connection.sink->_engineIndex] = depth;
+        changed = true;
+      }
+    }
+  }
+
+  // Sort connections by depth of their source (insertion sort, stable with respect to declaration order).
+  for (size_t i = 0; i != _connections.size(); i++) {
+    Connection connection = _connections[i];
+    connection.depth = (connection.source ? depths[connection.source->_engineIndex] : 0);
+    size_t j = i;
+    while (j > 0 && _connections[j-1].depth > connection.depth) {
+      _connections[j] = _connections[j-1];
+      j--;
+    }
+    _connections[j] = connection;
+  }
+
+  return true;
 }
 
 micro_seconds_t Engine::_updateGlobalMicroSeconds() const {
-  // Get current global time.
-  uint32_t us = _clock();
-  uint32_t prevUs = _totalGlobalMicroSeconds.micros32.base;
+  // Virtual clock: time only moves forward in timeStep().
+  if (_virtualDeltaTimeMicroSeconds)
+    return _totalGlobalMicroSeconds;
+
+  // Child engine: time is the reference time of the parent.
+  if (_parent)
+    return (_totalGlobalMicroSeconds = _parent->_microSeconds);
 
-  // Detect overflow.
-  if (us < prevUs)
-    _totalGlobalMicroSeconds.micros32.overflows++;
+  // 64-bit clock: no overflow to detect.
+  if (_clockFunction64)
+    _realMicroSeconds.micros64 = _clock64();
 
-  // Update previous time.
-  _totalGlobalMicroSeconds.micros32.base = us;
+  else {
+    // Get current global time.
+    uint32_t us = _clock();
+    uint32_t prevUs = _realMicroSeconds.micros32.base;
+
+    // Detect overflow.
+    if (us < prevUs)
+      _realMicroSeconds.micros32.overflows++;
+
+    // Update previous time.
+    _realMicroSeconds.micros32.base = us;
+  }
+
+  // Apply time scale.
+  uint64_t elapsed = _realMicroSeconds.micros64 - _timeScaleRealOriginMicroSeconds;
+  if (_timeScaleFixed16 != TIME_SCALE_FIXED16_ONE) // split product to avoid overflow
+    elapsed = (elapsed >> 16) * _timeScaleFixed16 + (((elapsed & 0xFFFF) * _timeScaleFixed16) >> 16);
+  _totalGlobalMicroSeconds.micros64 = _timeScaleOriginMicroSeconds + elapsed;
 
   return _totalGlobalMicroSeconds;
 }
 
+void Engine::_restartClock() {
+  _totalGlobalMicroSeconds.micros64 = _realMicroSeconds.micros64 = 0;
+  _timeScaleOriginMicroSeconds = _timeScaleRealOriginMicroSeconds = 0;
+}
+
+void Engine::timeScale(float scale) {
+  // Restart scaled time from current time (time of virtual clocks and child engines is not read from the clock).
+  if (!_virtualDeltaTimeMicroSeconds && !_parent) {
+    _updateGlobalMicroSeconds();
+    _timeScaleOriginMicroSeconds = _totalGlobalMicroSeconds.micros64;
+    _timeScaleRealOriginMicroSeconds = _realMicroSeconds.micros64;
+  }
+
+  _timeScale = constrain(scale, 1.0f / TIME_SCALE_FIXED16_ONE, 65535.0f);
+  _timeScaleFixed16 = static_cast<uint32_t>(round(_timeScale * TIME_SCALE_FIXED16_ONE));
+}
+
+void Engine::virtualClock(float sampleRate) {
+  float period = max(MICROS_PER_SECOND/max(sampleRate, FLT_MIN), 1.0f);
+  splitMicroSeconds(period, _virtualDeltaTimeMicroSeconds, _virtualDeltaTimeFraction);
+  _virtualTimeFraction = 0;
+  _setStableDeltaTime(static_cast<uint32_t>(round(period)));
+}
+
+void Engine::noVirtualClock() {
+  if (_virtualDeltaTimeMicroSeconds) {
+    _virtualDeltaTimeMicroSeconds = _virtualDeltaTimeFraction = 0;
+
+    // Virtual time cannot be reconciled with reference clock: restart from it.
+    _restartClock();
+    if (_beginCompleted) {
+      begin(); // redo the begin with the reference clock
+    }
+  }
+}
+
+#if PQ_TIMING_STATS
+void Engine::_updateTimingStats(bool firstPoll) {
+  // Delay relative to target time.
+  uint64_t lateness = _totalGlobalMicroSeconds.micros64 - _targetTime.micros64;
+  uint32_t lateness32 = (lateness > UINT32_MAX ? UINT32_MAX : (uint32_t)lateness);
+  if (lateness32 > _maxLatenessMicroSeconds)
+    _maxLatenessMicroSeconds = lateness32;
+
+  // Difference between actual and target period.
+  uint32_t period = _totalGlobalMicroSeconds.micros32.base - _microSeconds.micros32.base;
+  _jitterProfile.add(period > _targetDeltaTimeMicroSeconds ?
+                       period - _targetDeltaTimeMicroSeconds :
+                       _targetDeltaTimeMicroSeconds - period);
+
+  // Target was already behind us when we first checked: we missed the deadline.
+  if (firstPoll && lateness) {
+    _nOverruns++;
+    if (_overrunCallback)
+      _overrunCallback();
+  }
+}
+
+void Engine::resetTimingStats() {
+  _nOverruns = 0;
+  _maxLatenessMicroSeconds = 0;
+  _jitterProfile.reset();
+}
+#endif
+
 void Engine::autoSampleRate() {
   // Enable auto sample rate mode.
   _autoSampleRate = true;
@@ -194,6 +633,9 @@ void Engine::autoSampleRate() {
   _targetSampleRate = 0;
   _targetDeltaTimeMicroSeconds = 0; // unused
   _stepState = STEP_INIT;
+
+  // Sample rate is unknown until next step.
+  _setStableDeltaTime(0);
 }
 
 void Engine::sampleRate(float sampleRate) {
@@ -202,7 +644,14 @@ void Engine::sampleRate(float sampleRate) {
 
   // Set target sample rate and delta time in us.
   _targetSampleRate = max(sampleRate, FLT_MIN);
-  _targetDeltaTimeMicroSeconds = static_cast<uint32_t>(round(MICROS_PER_SECOND/_targetSampleRate));
+  float period = MICROS_PER_SECOND/_targetSampleRate;
+  splitMicroSeconds(period, _targetDeltaTimeMicroSeconds, _targetDeltaTimeFraction);
+  _setStableDeltaTime(static_cast<uint32_t>(round(period)));
+
+  // Restart schedule from last step.
+  _targetTime = _microSeconds;
+  _targetTimeFraction = 0;
+  _stepState = STEP_INIT;
 }
 
 void Engine::samplePeriod(float samplePeriod) {
@@ -215,12 +664,71 @@ bool Engine::randomTrigger(float timeWindow) {
 
 void Engine::referenceClock(unsigned long (*clockFunction)()) {
   _clockFunction = clockFunction;
+  _clockFunction64 = 0;
+  _restartClock();
+  if (_beginCompleted) {
+    begin(); // redo the begin with the new time function
+  }
+}
+
+void Engine::referenceClock(uint64_t (*clockFunction)(), uint32_t ticksPerSecond) {
+  _clockFunction64 = clockFunction;
+  _clockTicksPerSecond = max(ticksPerSecond, (uint32_t)1);
+  _restartClock();
   if (_beginCompleted) {
     begin(); // redo the begin with the new time function
   }
 }
 
+uint64_t Engine::_clock64() const {
+  uint64_t ticks = _clockFunction64();
+  if (_clockTicksPerSecond == MICROS_PER_SECOND)
+    return ticks;
+  // Split conversion to avoid overflow.
+  return (ticks / _clockTicksPerSecond) * MICROS_PER_SECOND +
+         (ticks % _clockTicksPerSecond) * MICROS_PER_SECOND / _clockTicksPerSecond;
+}
+
+#if PQ_PROFILE
+void Engine::resetProfile() {
+  for (size_t i = 0; i != _units.size(); i++) {
+    if (_units[i])
+      _units[i]->_stepProfile.reset();
+  }
+  _eventsProfile.reset();
+}
+
+void Engine::printProfile() {
+  // Rank units by decreasing total step time (insertion sort).
+  HybridArrayList<Unit*, PLAQUETTE_MAX_UNITS> ranked;
+  for (size_t i = 0; i != _units.size(); i++) {
+    Unit* unit = _units[i];
+    if (!unit)
+      continue;
+    size_t j = ranked.size();
+    while (j > 0 && ranked[j-1]->_stepProfile.totalMicroSeconds() < unit->_stepProfile.totalMicroSeconds())
+      j--;
+    ranked.insert(j, unit);
+  }
+
+  // Print one line per unit, identified by its position in the engine.
+  for (size_t i = 0; i != ranked.size(); i++) {
+    print("unit ");
+    print((unsigned long)ranked[i]->_engineIndex);
+    print(": ");
+    ranked[i]->_stepProfile.print();
+    println();
+  }
+
+  print("events: ");
+  _eventsProfile.print();
+  println();
+}
+#endif
+
 void referenceClock(unsigned long (*clockFunction)()) { Plaquette.referenceClock(clockFunction); }
+
+void referenceClock(uint64_t (*clockFunction)(), uint32_t ticksPerSecond) { Plaquette.referenceClock(clockFunction, ticksPerSecond); }
 unsigned long nSteps() { return Plaquette.nSteps(); }
 bool hasAutoSampleRate() { return Plaquette.hasAutoSampleRate(); }
 void autoSampleRate() { Plaquette.autoSampleRate(); }
@@ -230,19 +738,69 @@ float sampleRate() { return Plaquette.sampleRate(); }
 float samplePeriod() { return Plaquette.samplePeriod(); }
 bool randomTrigger(float timeWindow) { return Plaquette.randomTrigger(timeWindow); }
 
-Unit::Unit(Engine& engineRef) : _engine(0) {
+Unit::Unit(Engine& engineRef)
+  : _engine(0), _engineIndex(0), _dormant(false), _priority(PRIORITY_DEFAULT), _listenedEvents(0), _raisedEvents(0), _deferred(false),
+    _decimation(1), _decimationCounter(0), _lastStepMicroSeconds(0), _deltaTimeMicroSeconds(0) {
   engineRef.add(this);
 }
 
 Unit::~Unit() {
+  // Deregister from engine, including event listeners.
+  if (_engine) {
+    _engine->_eventManager.clearListeners(this);
+    _engine->remove(this);
+  }
+}
+
+void Unit::priority(uint8_t priority) {
+  _priority = priority;
+
+  // Engine needs to sort units again.
+  if (_engine)
+    _engine->_activeUnitsDirty = true;
+}
+
+void Unit::decimation(uint16_t decimation) {
+  _decimation = max(decimation, (uint16_t)1);
+  _restartDecimation();
+
+  // Sample rate of unit changed.
+  if (_engine)
+    _engine->_sampleRateVersion++;
+}
+
+void Unit::_restartDecimation() {
+  _decimationCounter = _decimation - 1;
+  _lastStepMicroSeconds = _engine ? _engine->_microSeconds.micros32.base : 0;
+  _deltaTimeMicroSeconds = 0;
+}
+
+float Unit::deltaTimeSecondsTimesFixed32Max() const {
+  if (_decimation == 1 && !_deferred)
+    return _engine->deltaTimeSecondsTimesFixed32Max();
+
+  // Same computation as engine, based on time between steps of this unit.
+  return microsToSecondsTimesFixed32Max(_deltaTimeMicroSeconds);
 }
 
 void Unit::clearEvents() {
   _engine->_eventManager.clearListeners(this);
 }
 
+void Unit::removeEvent(EventCallback callback, EventType eventType) {
+  _engine->_eventManager.removeListener(this, callback, eventType);
+}
+
+void Unit::removeEvent(EventContextCallback callback, void* context, EventType eventType) {
+  _engine->_eventManager.removeListener(this, callback, context, eventType);
+}
+
 void Unit::onEvent(EventCallback callback, EventType eventType) {
   _engine->_eventManager.addListener(this, callback, eventType);
 }
 
+void Unit::onEvent(EventContextCallback callback, void* context, EventType eventType) {
+  _engine->_eventManager.addListener(this, callback, context, eventType);
+}
+
 } // namespace pq
@@ -41,6 +41,7 @@
 #include "pq_map.h"
 #include "pq_phase_utils.h"
 #include "pq_print.h"
+#include "pq_profile.h"
 #include "pq_random.h"
 #include "pq_time.h"
 
@@ -55,11 +56,23 @@ enum {
   SINK = INVERTED  // deprecated
 };
 
+/// @brief Step priority classes of units (units with lower priority values are stepped first).
+enum {
+  PRIORITY_INPUT   = 64,
+  PRIORITY_FILTER  = 128,
+  PRIORITY_OUTPUT  = 192,
+  PRIORITY_DEFAULT = PRIORITY_FILTER
+};
+
 class Unit;
+class StateArchive;
+class StateReader;
+class StateWriter;
 
 /// The main Plaquette static class containing all the units.
 class Engine {
   friend class Unit;
+  friend class EventTrace;
 
 public:
   Engine();
@@ -86,6 +99,12 @@ public:
   /// Function to be used within the PlaquetteLib context (needs to be called at top of loop() method).
   inline bool step();
 
+  /**
+   * Blocking version of step(): waits until the next step is due (using the wait function, see
+   * waitFunction()) and performs it. Useful to save CPU and power in fixed sample rate mode.
+   */
+  void stepBlocking();
+
   /**
    * Optional function to be used within the PlaquetteLib context. No need to call it if the program
    * is looping indefinitely. Call if the program stops at some point.
@@ -93,7 +112,87 @@ public:
   inline void end();
 
   /// Returns the current number of units.
-  size_t nUnits() { return _unitsEndIndex - _unitsBeginIndex; }
+  size_t nUnits() const { return _units.size() - _nRemovedUnits; }
+
+  /**
+   * Declares a permanent connection from a source unit to a sink unit. At each step, after all units
+   * have been stepped, the engine sends the value of the source to the sink (ie. source >> sink),
+   * following the order of the data flow so that a value propagates through an entire chain of
+   * connections within the same step, regardless of the order in which units were created.
+   * Both units must belong to this engine. Connections that would create a cycle are refused.
+   * @param source the unit to read from
+   * @param sink the unit to write to
+   * @return true if the connection exists after the call
+   */
+  bool connect(Unit& source, Unit& sink);
+
+  /**
+   * Removes a connection declared with connect().
+   * @param source the unit to read from
+   * @param sink the unit to write to
+   * @return true if the connection existed
+   */
+  bool disconnect(Unit& source, Unit& sink);
+
+  /// Returns the current number of connections.
+  size_t nConnections() const { return _connections.size() - _nRemovedConnections; }
+
+  /**
+   * Saves the state of all units (eg. filter statistics, oscillator phases, timer progress) so that
+   * it can be restored with loadState(), for example after a restart. Configuration set by the program
+   * (eg. time windows, frequencies) is not saved.
+   * @param writer where to save the state (eg. a StreamStateWriter or BufferStateWriter)
+   * @return true on success
+   */
+  bool saveState(StateWriter& writer);
+
+  /**
+   * Restores the state of all units saved with saveState(). Should be called after begin().
+   * The program should contain the same units, created in the same order, as when state was saved.
+   * Units whose state does not match are left unchanged.
+   * @param reader where to load the state from (eg. a StreamStateReader or BufferStateReader)
+   * @return true on success
+   */
+  bool loadState(StateReader& reader);
+
+  /**
+   * Adds a child engine, which is then stepped by this engine once every N steps (after this engine's
+   * units and events). The child takes its time from this engine's reference time instead of reading a
+   * clock, so that it stays exactly aligned with this engine. The child is initialized when this engine
+   * begins, and should no longer be stepped directly.
+   * @param child the child engine
+   * @param divider the number of steps of this engine per step of the child (1 = every step)
+   * @return false if the child is this engine or one of its ancestors
+   */
+  bool addChild(Engine& child, uint16_t divider=1);
+
+  /**
+   * Removes a child engine added with addChild(). The child restarts using its own reference clock.
+   * @param child the child engine
+   * @return true if the engine was a child of this engine
+   */
+  bool removeChild(Engine& child);
+
+  /**
+   * Sets a time budget for the stepping of units. When stepping units takes longer than the budget,
+   * the remaining priority classes (see Unit::priority()) are deferred to the next step, during which
+   * all units are stepped regardless of the budget. Units of the first priority class are always stepped.
+   * Deferred units step over the time elapsed since their last step (see Unit::deltaTimeMicroSeconds()).
+   * @param microSeconds the budget in microseconds (0 = no budget)
+   */
+  void stepBudget(uint32_t microSeconds) { _stepBudgetMicroSeconds = microSeconds; }
+
+  /// Returns the time budget for the stepping of units in microseconds (0 = no budget).
+  uint32_t stepBudget() const { return _stepBudgetMicroSeconds; }
+
+  /// Returns the number of steps in which some units were deferred due to the step budget since begin().
+  unsigned long nDeferredSteps() const { return _nDeferredSteps; }
+
+  /// Returns the current number of child engines.
+  size_t nChildren() const { return _children.size(); }
+
+  /// Returns the parent engine (null if none).
+  Engine* parent() const { return _parent; }
 
   /**
    * Returns time in seconds. Optional parameter allows to ask for reference time (default)
@@ -138,16 +237,39 @@ public:
   void samplePeriod(float samplePeriod);
 
   /// Returns sample rate.
-  float sampleRate() const { return _sampleRate; }
+  float sampleRate() const { return (_sampleRate ? _sampleRate : (_sampleRate = _trueSampleRate())); }
 
   /// Returns sample period.
-  float samplePeriod() const { return (_samplePeriod ? _samplePeriod : (_samplePeriod = frequencyToPeriod(_sampleRate))); }
+  float samplePeriod() const { return (_samplePeriod ? _samplePeriod : (_samplePeriod = frequencyToPeriod(sampleRate()))); }
 
   /// Returns time between steps (in microseconds).
   uint32_t deltaTimeMicroSeconds() const { return _deltaTimeMicroSeconds; }
 
+  /**
+   * Returns a smoothed and quantized version of the sample rate that only changes when the actual
+   * sample rate changes significantly (by more than about 3%). Units can use it to precompute
+   * rate-dependent coefficients, updating them only when sampleRateVersion() changes.
+   */
+  float stableSampleRate() const { return (_stableDeltaTimeMicroSeconds ? SECONDS_TO_MICROS / _stableDeltaTimeMicroSeconds : PLAQUETTE_MAX_SAMPLE_RATE); }
+
+  /// Returns a counter incremented each time stableSampleRate() changes.
+  uint16_t sampleRateVersion() const { return _sampleRateVersion; }
+
+  /// Returns real time remaining until next step is due (in microseconds). Always zero in auto sample rate mode.
+  uint32_t microSecondsUntilNextStep();
+
+  /**
+   * Sets function used by stepBlocking() to wait for a given number of microseconds.
+   * Default: sleeps on host (EpoxyDuino), otherwise none (busy polling).
+   * @param waitFunction pointer to a function that waits for a given number of microseconds (or null for busy polling)
+   */
+  void waitFunction(void (*waitFunction)(uint32_t microSeconds)) { _waitFunction = waitFunction; }
+
   /// Returns time between steps, expressed in fixed point propotion.
-  float deltaTimeSecondsTimesFixed32Max() const { return _deltaTimeSecondsTimesFixed32Max; }
+  float deltaTimeSecondsTimesFixed32Max() const {
+    return (_deltaTimeSecondsTimesFixed32Max >= 0 ? _deltaTimeSecondsTimesFixed32Max :
+            (_deltaTimeSecondsTimesFixed32Max = microsToSecondsTimesFixed32Max(_deltaTimeMicroSeconds)));
+  }
 
   /// Returns the main instance of Plaquette.
   static Engine& primary();
@@ -171,6 +293,191 @@ public:
   /// @param clockFunction pointer to a function returning microseconds
   void referenceClock(unsigned long (*clockFunction)());
 
+  /**
+   * Sets base function returning a 64-bit tick count at a given resolution (eg. nanoseconds on a
+   * host). Since the count does not wrap around, no overflow detection is needed.
+   * @param clockFunction pointer to a function returning the number of ticks
+   * @param ticksPerSecond number of ticks per second (eg. 1000000000 for nanoseconds)
+   */
+  void referenceClock(uint64_t (*clockFunction)(), uint32_t ticksPerSecond);
+
+  /**
+   * Enables virtual clock (simulation) mode: each step advances the engine's time by exactly one
+   * sample period without reading the reference clock nor waiting, allowing to run a program faster
+   * than real time. Periods that are not a whole number of microseconds are accumulated so that the
+   * average sample rate is exact.
+   * @param sampleRate the simulated sample rate (in Hz)
+   */
+  void virtualClock(float sampleRate);
+
+  /// Disables virtual clock mode and restarts the engine using the reference clock.
+  void noVirtualClock();
+
+  /**
+   * Sets the speed at which the engine's time flows relative to the reference clock, allowing to
+   * run all units in fast-forward (eg. 10) or in slow motion (eg. 0.1) without changing their
+   * parameters. In fixed sample rate mode, the sample rate is expressed in the engine's time: the
+   * time step seen by units stays the same while steps are taken faster or slower in real time.
+   * Has no effect in virtual clock mode or on child engines (which follow their parent's time).
+   * @param scale the time scale (default: 1)
+   */
+  void timeScale(float scale);
+
+  /// Returns the time scale.
+  float timeScale() const { return _timeScale; }
+
+  /**
+   * Enables the event queue: instead of calling event callbacks during step(), events are recorded
+   * in a bounded queue with their step number and time, and callbacks are called when the program
+   * calls dispatchEvents(), on its own schedule or in batches. Events of the same type from the same
+   * unit are recorded once per step. If the queue is full, the oldest event is dispatched during
+   * step() to make room (see nEventQueueOverflows()).
+   * @param capacity maximum number of queued events (0: disable)
+   * @return false if the queue could not be allocated
+   */
+  bool eventQueue(size_t capacity) { return _eventManager.enableQueue(capacity); }
+
+  /// Dispatches remaining queued events and disables the event queue (default).
+  void noEventQueue() { _eventManager.disableQueue(); }
+
+  /// Returns true iff the event queue is enabled.
+  bool hasEventQueue() const { return _eventManager.hasQueue(); }
+
+  /**
+   * Calls callbacks of queued events, oldest first.
+   * @param maxEvents maximum number of events to dispatch (default: all)
+   * @return number of events dispatched
+   */
+  size_t dispatchEvents(size_t maxEvents = (size_t)-1) { return _eventManager.dispatchQueue(maxEvents); }
+
+  /// Returns number of events waiting in the event queue.
+  size_t nQueuedEvents() const { return _eventManager.nQueuedEvents(); }
+
+  /// Returns number of events dispatched during step() because the event queue was full.
+  unsigned long nEventQueueOverflows() const { return _eventManager.nQueueOverflows(); }
+
+  /// Returns step number at which the event being dispatched by dispatchEvents() occurred.
+  unsigned long eventStep() const { return _eventManager.queuedEventStep(); }
+
+  /// Returns reference time at which the event being dispatched by dispatchEvents() occurred (in microseconds).
+  uint32_t eventMicroSeconds() const { return _eventManager.queuedEventMicroSeconds(); }
+
+  /**
+   * Enables the event trace: the beginning of each step and each call to an event callback are
+   * recorded with their step number and reference time in a ring buffer, which can be dumped
+   * with dumpEventTrace() to measure event latency. When full, the oldest records are overwritten.
+   * @param capacity maximum number of records
+   * @return false if the trace could not be allocated
+   */
+  bool eventTrace(size_t capacity) { return _eventManager.enableTrace(this, capacity); }
+
+  /// Disables the event trace (default) and frees its memory.
+  void noEventTrace() { _eventManager.disableTrace(); }
+
+  /// Returns true iff the event trace is enabled.
+  bool hasEventTrace() const { return _eventManager.trace() != NULL; }
+
+  /// Returns number of records in the event trace.
+  size_t nEventTraceRecords() const { return _eventManager.trace() ? _eventManager.trace()->size() : 0; }
+
+  /// Removes all records from the event trace.
+  void clearEventTrace() { if (_eventManager.trace()) _eventManager.trace()->clear(); }
+
+  /**
+   * Writes the event trace in binary form (see EventTrace).
+   * @param writer where to write the trace (eg. StreamStateWriter, FileStateWriter)
+   * @return false if the trace is disabled or could not be written
+   */
+  bool dumpEventTrace(StateWriter& writer) const { return _eventManager.trace() && _eventManager.trace()->dump(writer); }
+
+  /// Returns true iff virtual clock mode is enabled.
+  bool hasVirtualClock() const { return _virtualDeltaTimeMicroSeconds != 0; }
+
+  /**
+   * Enables catch-up mode for fixed sample rate (see sampleRate(float)). In this mode, steps are
+   * taken at their target times so that time always advances by the nominal sample period. When
+   * the engine falls behind its schedule by one sample period or more, instead of taking a single
+   * long step, step() returns true without waiting until the engine is back on schedule, so that
+   * filters and oscillators always see the designed time step. If the engine is still behind after
+   * maxSteps consecutive catch-up steps, the remaining delay is absorbed in a single step and the
+   * schedule restarts from the current time.
+   * @param maxSteps maximum number of consecutive catch-up steps (0: disable)
+   */
+  void catchUp(uint16_t maxSteps) { _maxCatchUpSteps = maxSteps; _catchUpCount = 0; }
+
+  /// Disables catch-up mode (default).
+  void noCatchUp() { catchUp(0); }
+
+  /// Returns true iff catch-up mode is enabled.
+  bool hasCatchUp() const { return _maxCatchUpSteps != 0; }
+
+  /// Returns the number of catch-up steps performed since begin().
+  unsigned long nCatchUpSteps() const { return _nCatchUpSteps; }
+
+#if PQ_TIMING_STATS
+  /**
+   * Returns number of steps that missed their deadline in fixed sample rate mode, ie.
+   * steps that were already late when timeStep() was first called after the previous step.
+   */
+  unsigned long nOverruns() const { return _nOverruns; }
+
+  /// Returns worst delay of a step relative to its target time in fixed sample rate mode (in microseconds).
+  uint32_t maxLatenessMicroSeconds() const { return _maxLatenessMicroSeconds; }
+
+  /// Returns statistics of the difference between actual and target step period in fixed sample rate mode (in microseconds).
+  const StepProfile& jitterProfile() const { return _jitterProfile; }
+
+  /// Clears deadline and jitter statistics.
+  void resetTimingStats();
+
+  /// Registers callback called whenever a step misses its deadline in fixed sample rate mode.
+  void onOverrun(EventCallback callback) { _overrunCallback = callback; }
+#endif
+
+#if PQ_PROFILE
+  /// Returns execution time statistics of the event pass.
+  const StepProfile& eventsProfile() const { return _eventsProfile; }
+
+  /// Clears execution time statistics of all units and of the event pass.
+  void resetProfile();
+
+  /// Prints execution time statistics of units (ranked by total time) and of the event pass on the console.
+  void printProfile();
+#endif
+
+protected:
+  // Internal use. Performs post-begin on first run, otherwise time step. Returns true iff units need to be stepped.
+  inline bool _stepTime();
+
+  // Internal use. Steps a unit that is not dormant (skipping steps of decimated units).
+  inline void _stepUnit(Unit* unit);
+
+  // Internal use. Steps a unit that is not dormant through a direct call to its step() (see StaticEngine).
+  template<typename U>
+  inline void _stepStaticUnit(U& unit) {
+    if (_unitStepDue(&unit)) {
+#if PQ_PROFILE
+      uint32_t startTime = micros();
+      unit.staticStep();
+      unit._stepProfile.add(micros() - startTime);
+#else
+      unit.staticStep();
+#endif
+    }
+  }
+
+  // Internal use. Returns true iff a unit that is not dormant needs to be stepped (decimated units skip steps).
+  inline bool _unitStepDue(Unit* unit);
+
+  // Internal use. Propagates connections and triggers events once units have been stepped.
+  inline void _endStep();
+
+  // Internal use. Waits until next step is due using wait function (see stepBlocking()).
+  void _waitUntilNextStep();
+
+  // Function stepping the units in place of the active units loop (set by StaticEngine, null otherwise).
+  void (*_stepUnitsFunction)(Engine& engine);
+
 private:
   /// Adds a component to Plaquette.
   void add(Unit* component);
@@ -178,28 +485,120 @@ private:
   /// Removes a component from Plaquette.
   void remove(Unit* component);
 
-  // Internal use. Sets sample rate and sample period.
-  inline void _setSampleRate(float sampleRate);
+  // Internal use. Reclaims the empty slots left in _units by remove().
+  void _compactUnits();
+
+  // Internal use. Reclaims the empty slots left in _connections by remove() and disconnect().
+  void _compactConnections();
+
+  // Internal use. Sorts connections in data flow order. Returns false if connections contain a cycle.
+  bool _sortConnections();
+
+  // Internal use. Rebuilds the list of units that are not dormant.
+  void _updateActiveUnits();
+
+  // Internal use. Steps child engines that are due.
+  void _stepChildren();
+
+  // Internal use. Detaches a child engine. Returns false if not found.
+  bool _detachChild(Engine* child);
+
+  // Internal use. Updates stable sample rate from time between steps.
+  inline void _updateStableSampleRate();
+
+  // Internal use. Sets stable sample rate from time between steps (in microseconds).
+  void _setStableDeltaTime(uint32_t deltaTimeMicroSeconds) {
+    _stableDeltaTimeMicroSeconds = _smoothedDeltaTimeMicroSeconds = deltaTimeMicroSeconds;
+    _sampleRateVersion++;
+  }
+
+  // Returns actual sample rate based on time between steps.
+  float _trueSampleRate() const { return (_deltaTimeMicroSeconds ? SECONDS_TO_MICROS / _deltaTimeMicroSeconds : PLAQUETTE_MAX_SAMPLE_RATE); }
 
   // Returns current reference time in microseconds.
-  unsigned long _clock() const { return _clockFunction ? _clockFunction() : micros(); }
+  unsigned long _clock() const {
+    return _clockFunction64 ? static_cast<unsigned long>(_clock64()) : _clockFunction ? _clockFunction() : micros();
+  }
+
+  // Returns current time of 64-bit reference clock in microseconds.
+  uint64_t _clock64() const;
+
+  // Returns target time of next step, ie. target time of previous step + target period.
+  inline micro_seconds_t _nextTargetTime() const;
+
+  // Restarts global time from reference clock.
+  void _restartClock();
 
   // Internal use, needs to be called periodically. Updates _totalGlobalMicroSeconds.
   micro_seconds_t _updateGlobalMicroSeconds() const;
 
+#if PQ_TIMING_STATS
+  // Internal use. Updates deadline and jitter statistics of a step in fixed sample rate mode.
+  void _updateTimingStats(bool firstPoll);
+#endif
+
 private:
-  // Shared static container containing all units. Static because it is shared between all engines.
-  // Units from the primary engine are always located at the begnning, then units from other engines.
-  static HybridArrayList<Unit*, PLAQUETTE_MAX_UNITS>& units();
+  // Container holding this engine's units (in order of registration).
+  // Removed units leave a null slot behind until the next call to _compactUnits().
+  HybridArrayList<Unit*, PLAQUETTE_MAX_UNITS> _units;
+
+  // Number of null slots in _units waiting to be reclaimed.
+  size_t _nRemovedUnits;
 
-  // Range of this engine's units within the _units array list.
-  size_t _unitsBeginIndex; // begin index
-  size_t _unitsEndIndex;   // end index (= _unitsBeginIndex + nUnits())
+  // Positions in _units of units that are not dormant (in order of registration).
+  // 16-bit positions keep the list small on 8-bit boards (engines hold far fewer than 65536 units).
+  HybridArrayList<uint16_t, 8> _activeUnits;
+
+  // True if _activeUnits needs to be rebuilt (eg. after a unit was added or woken up).
+  bool _activeUnitsDirty;
+
+  // A connection from a source unit to a sink unit (see connect()).
+  struct Connection {
+    // Connected units (both null if the connection was removed).
+    Unit* source;
+    Unit* sink;
+
+    // Length of the longest chain of connections leading to source (used for sorting).
+    size_t depth;
+  };
 
-  // Sampling rate (ie. how many times per seconds step() is called).
-  float _sampleRate;
+  // Connections, sorted in data flow order.
+  HybridArrayList<Connection, 4> _connections;
 
-  // Sampling period (ie. 1.0 / sampleRate()).
+  // Number of null slots in _connections waiting to be reclaimed.
+  size_t _nRemovedConnections;
+
+  // A child engine (see addChild()).
+  struct Child {
+    // The child engine.
+    Engine* engine;
+
+    // Number of steps per step of the child.
+    uint16_t divider;
+
+    // Number of steps remaining before next step of the child.
+    uint16_t counter;
+  };
+
+  // Child engines (in order of addition).
+  HybridArrayList<Child, 2> _children;
+
+  // Parent engine (null if none).
+  Engine* _parent;
+
+  // Time budget for the stepping of units (zero if none).
+  uint32_t _stepBudgetMicroSeconds;
+
+  // Number of steps in which units were deferred.
+  unsigned long _nDeferredSteps;
+
+  // True if units were deferred during previous step.
+  bool _deferredStep;
+
+  // Sampling rate (ie. how many times per seconds step() is called). Computed on demand (zero if not computed yet).
+  mutable float _sampleRate;
+
+  // Sampling period (ie. 1.0 / sampleRate()). Computed on demand (zero if not computed yet).
   mutable float _samplePeriod;
 
   // Whether the auto sample rate mode is activated.
@@ -209,7 +608,8 @@ private:
   micro_seconds_t _microSeconds;
   // uint32_t _previousMicroSeconds; // This is the 32 first bits of microseconds used for inter-step calculations.
 
-  // Target time for next step (when using sampleRate(float)).
+  // Target time for next step (when using sampleRate(float)). Updated from previous target time
+  // rather than from actual step time to prevent drift.
   micro_seconds_t _targetTime;
 
   // Step state for state machine to manage sample rate.
@@ -225,12 +625,45 @@ private:
   // Number of microseconds between steps.
   uint32_t _deltaTimeMicroSeconds;
 
-  // Number of seconds between steps time FIXED_32_MAX.
-  float _deltaTimeSecondsTimesFixed32Max;
+  // Number of seconds between steps time FIXED_32_MAX. Computed on demand (negative if not computed yet).
+  mutable float _deltaTimeSecondsTimesFixed32Max;
+
+  // Smoothed number of microseconds between steps.
+  uint32_t _smoothedDeltaTimeMicroSeconds;
+
+  // Number of microseconds between steps used to compute stable sample rate (zero if unknown).
+  uint32_t _stableDeltaTimeMicroSeconds;
+
+  // Incremented each time stable sample rate changes.
+  uint16_t _sampleRateVersion;
 
   // Number of microseconds between steps.
   uint32_t _targetDeltaTimeMicroSeconds;
 
+  // Fractional part of microseconds between steps (in 1/2^32 microseconds).
+  uint32_t _targetDeltaTimeFraction;
+
+  // Accumulated fractional part of target time (in 1/2^32 microseconds).
+  uint32_t _targetTimeFraction;
+
+  // Number of microseconds added at each step in virtual clock mode (zero if disabled).
+  uint32_t _virtualDeltaTimeMicroSeconds;
+
+  // Fractional part of microseconds added at each step in virtual clock mode (in 1/2^32 microseconds).
+  uint32_t _virtualDeltaTimeFraction;
+
+  // Accumulated fractional part of virtual time (in 1/2^32 microseconds).
+  uint32_t _virtualTimeFraction;
+
+  // Maximum number of consecutive catch-up steps (zero if catch-up mode is disabled).
+  uint16_t _maxCatchUpSteps;
+
+  // Number of consecutive catch-up steps in current overrun.
+  uint16_t _catchUpCount;
+
+  // Total number of catch-up steps.
+  unsigned long _nCatchUpSteps;
+
   // Number of steps accomplished.
   unsigned long _nSteps;
 
@@ -252,6 +685,49 @@ private:
   // Functions that return time in microseconds (default: micros()).
   unsigned long (*_clockFunction)();
 
+  // Function that returns time in 64-bit ticks (overrides _clockFunction if set).
+  uint64_t (*_clockFunction64)();
+
+  // Number of ticks per second of _clockFunction64.
+  uint32_t _clockTicksPerSecond;
+
+  // Time of reference clock in microseconds.
+  mutable micro_seconds_t _realMicroSeconds;
+
+  // Time scale.
+  float _timeScale;
+
+  // Time scale in 16.16 fixed point.
+  uint32_t _timeScaleFixed16;
+
+  // Global time when time scale was last changed.
+  uint64_t _timeScaleOriginMicroSeconds;
+
+  // Reference clock time when time scale was last changed.
+  uint64_t _timeScaleRealOriginMicroSeconds;
+
+  // Function used to wait in stepBlocking().
+  void (*_waitFunction)(uint32_t microSeconds);
+
+#if PQ_TIMING_STATS
+  // Number of steps that missed their deadline.
+  unsigned long _nOverruns;
+
+  // Worst delay of a step relative to its target time.
+  uint32_t _maxLatenessMicroSeconds;
+
+  // Statistics of the difference between actual and target step period.
+  StepProfile _jitterProfile;
+
+  // Callback on overrun.
+  EventCallback _overrunCallback;
+#endif
+
+#if PQ_PROFILE
+  // Execution time statistics of the event pass.
+  StepProfile _eventsProfile;
+#endif
+
 private:
   // Prevent copy-construction and assignment.
   Engine(const Engine&);
@@ -264,6 +740,9 @@ extern Engine& Plaquette;
 /// Sets base function returning microseconds of primary engine. Default: micros().
 void referenceClock(unsigned long (*clockFunction)());
 
+/// Sets base function returning 64-bit ticks of primary engine at given resolution.
+void referenceClock(uint64_t (*clockFunction)(), uint32_t ticksPerSecond);
+
 /// Returns number of steps of primary engine.
 unsigned long nSteps();
 
@@ -346,15 +825,30 @@ class Chainable {
 class Unit : public Chainable {
   friend class Engine;
   friend class EventManager;
+  friend class EventTrace;
 
 protected:
   virtual void begin() {}
   virtual void step() {}
 
+  /**
+   * Saves or loads the state of the unit (see Engine::saveState()). Subclasses holding state that
+   * takes time to build up (eg. statistics) describe it here using the archive, with the same calls
+   * for saving and loading.
+   * @param archive the archive
+   */
+  virtual void serializeState(StateArchive& archive) {}
+
 public:
   // Clears all event listeners.
   virtual void clearEvents();
 
+  /// Removes event listeners registered with given callback for given event type.
+  virtual void removeEvent(EventCallback callback, EventType eventType);
+
+  /// Removes event listeners registered with given callback and user pointer for given event type.
+  virtual void removeEvent(EventContextCallback callback, void* context, EventType eventType);
+
   /// Returns engine time in seconds.
   float seconds() const { return _engine->seconds(); }
 
@@ -367,11 +861,55 @@ public:
   /// Returns number of engine steps.
   unsigned long nSteps() const { return _engine->nSteps(); }
 
-  /// Returns engine sample rate.
-  float sampleRate() const { return _engine->sampleRate(); }
+  /// Returns sample rate of the unit (ie. engine sample rate, divided by decimation factor).
+  float sampleRate() const {
+    return (_decimation == 1 ? _engine->sampleRate() :
+            _deltaTimeMicroSeconds ? SECONDS_TO_MICROS / _deltaTimeMicroSeconds : _engine->sampleRate() / _decimation);
+  }
+
+  /// Returns sample period of the unit (ie. engine sample period, multiplied by decimation factor).
+  float samplePeriod() const {
+    return (_decimation == 1 ? _engine->samplePeriod() :
+            _deltaTimeMicroSeconds ? _deltaTimeMicroSeconds * MICROS_TO_SECONDS : _engine->samplePeriod() * _decimation);
+  }
+
+  /// Returns time between steps of the unit (in microseconds).
+  uint32_t deltaTimeMicroSeconds() const { return (_decimation == 1 && !_deferred ? _engine->deltaTimeMicroSeconds() : _deltaTimeMicroSeconds); }
+
+  /// Returns stable sample rate of the unit (see Engine::stableSampleRate()).
+  float stableSampleRate() const { return (_decimation == 1 ? _engine->stableSampleRate() : _engine->stableSampleRate() / _decimation); }
+
+  /// Returns a counter incremented each time stableSampleRate() changes.
+  uint16_t sampleRateVersion() const { return _engine->sampleRateVersion(); }
+
+  /**
+   * Sets decimation factor: the unit is stepped only once every N engine steps, which saves CPU for
+   * units that do not need to run at full rate (eg. slow calibration). Time between steps of the unit
+   * (see sampleRate(), samplePeriod()) is the actual time elapsed between its steps.
+   * @param decimation the number of engine steps per step of the unit (1 = every step)
+   */
+  void decimation(uint16_t decimation);
+
+  /// Returns decimation factor (1 = unit is stepped at every engine step).
+  uint16_t decimation() const { return _decimation; }
+
+  /**
+   * Sets step priority class: the engine steps units by increasing priority value, and in order of
+   * creation within the same priority (eg. PRIORITY_INPUT, PRIORITY_FILTER, PRIORITY_OUTPUT).
+   * @param priority the priority value (default: PRIORITY_DEFAULT)
+   */
+  void priority(uint8_t priority);
+
+  /// Returns step priority class.
+  uint8_t priority() const { return _priority; }
 
-  /// Returns enginesample period.
-  float samplePeriod() const { return _engine->samplePeriod(); }
+  /// Returns true iff the unit is dormant, ie. its step() is skipped by the engine until it is woken up.
+  bool isDormant() const { return _dormant; }
+
+#if PQ_PROFILE
+  /// Returns execution time statistics of step().
+  const StepProfile& stepProfile() const { return _stepProfile; }
+#endif
 
 protected:
   /// Constructor.
@@ -381,13 +919,86 @@ protected:
   /// Returns true iff an event of a certain type has been triggered.
   virtual bool eventTriggered(EventType eventType) { return false; }
 
+  /**
+   * Returns true iff the unit raises events of a certain type itself with _raiseEvent() when its
+   * state changes. Otherwise, the event is polled at each step with eventTriggered().
+   */
+  virtual bool raisesEvent(EventType eventType) const { return false; }
+
+  /// Raises event: listeners of this event type will be called during the engine's event pass.
+  void _raiseEvent(EventType eventType) {
+    if (_listenedEvents & (1 << eventType))
+      _engine->_eventManager.raiseEvent(this, eventType);
+  }
+
   /// Registers event callback.
   virtual void onEvent(EventCallback callback, EventType eventType);
 
+  /// Registers event callback called with a user pointer.
+  virtual void onEvent(EventContextCallback callback, void* context, EventType eventType);
+
+  /**
+   * Makes the unit dormant: the engine stops calling step() until _wake() is called. Should
+   * only be called when further calls to step() would leave the unit unchanged (eg. a stopped timer).
+   */
+  void _sleep() { _dormant = true; }
+
+  /// Wakes up a dormant unit: the engine will call step() again starting from next step.
+  void _wake() {
+    if (_dormant) {
+      _dormant = false;
+      if (_engine) {
+        _engine->_activeUnitsDirty = true;
+        _lastStepMicroSeconds = _engine->_microSeconds.micros32.base; // do not count time spent dormant
+      }
+    }
+  }
+
+  /// Returns time between steps of the unit, expressed in fixed point propotion.
+  float deltaTimeSecondsTimesFixed32Max() const;
+
 private:
+  // Restarts decimation counter and time (unit will step on next engine step).
+  void _restartDecimation();
+
   // The engine that owns this unit.
   Engine* _engine;
 
+  // Position of this unit in its engine's unit list.
+  size_t _engineIndex;
+
+  // True iff step() is currently skipped by the engine (see _sleep()).
+  bool _dormant;
+
+  // Step priority class.
+  uint8_t _priority;
+
+  // Event types raised by this unit that have listeners (bit mask).
+  uint8_t _listenedEvents;
+
+  // Event types raised by this unit waiting to be dispatched (bit mask).
+  uint8_t _raisedEvents;
+
+  // True iff the unit was deferred by the engine's step budget and has not stepped since.
+  bool _deferred;
+
+  // Number of engine steps per step of this unit.
+  uint16_t _decimation;
+
+  // Number of engine steps since last step of this unit.
+  uint16_t _decimationCounter;
+
+  // Engine time of last step of this unit (used only if decimated or deferred).
+  uint32_t _lastStepMicroSeconds;
+
+  // Time between last two steps of this unit (used only if decimated or deferred).
+  uint32_t _deltaTimeMicroSeconds;
+
+#if PQ_PROFILE
+  // Execution time statistics of step().
+  StepProfile _stepProfile;
+#endif
+
 protected:
   /// Returns the engine that owns this unit.
   Engine* engine() const { return _engine; }
@@ -504,16 +1115,31 @@ public:
   /// Registers event callback on rise event.
   virtual void onRise(EventCallback callback)   { onEvent(callback, EVENT_RISE); }
 
+  /// Registers event callback on rise event, called with a user pointer.
+  virtual void onRise(EventContextCallback callback, void* context)   { onEvent(callback, context, EVENT_RISE); }
+
   /// Registers event callback on fall event.
   virtual void onFall(EventCallback callback)   { onEvent(callback, EVENT_FALL); }
 
+  /// Registers event callback on fall event, called with a user pointer.
+  virtual void onFall(EventContextCallback callback, void* context)   { onEvent(callback, context, EVENT_FALL); }
+
   /// Registers event callback on change event.
   virtual void onChange(EventCallback callback) { onEvent(callback, EVENT_CHANGE); }
 
+  /// Registers event callback on change event, called with a user pointer.
+  virtual void onChange(EventContextCallback callback, void* context) { onEvent(callback, context, EVENT_CHANGE); }
+
 protected:
   void _updateChangeState() {
     _changeState = (int8_t)_onValue - (int8_t)_prevOnValue;
     _prevOnValue = _onValue;
+
+    // Raise events.
+    if (_changeState) {
+      _raiseEvent(EVENT_CHANGE);
+      _raiseEvent(_changeState > 0 ? EVENT_RISE : EVENT_FALL);
+    }
   }
 
   /// Returns true iff an event of a certain type has been triggered.
@@ -526,6 +1152,14 @@ protected:
     }
   }
 
+  /**
+   * Returns true iff event type is raised by _updateChangeState(). Subclasses that call
+   * _updateChangeState() at each step can use it in raisesEvent().
+   */
+  static bool _isChangeEvent(EventType eventType) {
+    return (eventType == EVENT_CHANGE || eventType == EVENT_RISE || eventType == EVENT_FALL);
+  }
+
   // The value contained in the unit.
   bool    _onValue     : 1;
 
@@ -680,38 +1314,154 @@ protected:
 // Inline methods.
 
 void Engine::preStep() {
-  // Update every component.
-  for (size_t i=_unitsBeginIndex; i != _unitsEndIndex; i++) {
-    units()[i]->step();
+  // Reclaim slots of removed units and connections.
+  if (_nRemovedUnits)
+    _compactUnits();
+  if (_nRemovedConnections)
+    _compactConnections();
+
+  // Collect units that were added or woken up.
+  if (_activeUnitsDirty)
+    _updateActiveUnits();
+
+  _eventManager.traceStep(_nSteps);
+
+  // Static engine: units are stepped in their compile-time order (priorities and step budget do not apply).
+  if (_stepUnitsFunction) {
+    _stepUnitsFunction(*this);
+    _endStep();
+    return;
+  }
+
+  // Check step budget between priority classes, unless units were deferred at previous step.
+  bool checkBudget = (_stepBudgetMicroSeconds && !_deferredStep);
+  uint32_t startTime = (checkBudget ? _clock() : 0);
+  int priority = -1;
+  _deferredStep = false;
+
+  // Update every active component, dropping units that became dormant or were removed (order is preserved).
+  size_t nActiveUnits = 0;
+  for (size_t i=0; i != _activeUnits.size(); i++) {
+    uint16_t index = _activeUnits[i];
+    Unit* unit = _units[index];
+    if (unit && !unit->_dormant) {
+      _activeUnits[nActiveUnits++] = index;
+
+      // Entering a new priority class: defer it (and the following ones) if over budget.
+      if (checkBudget && unit->_priority != priority) {
+        if (priority >= 0 && _clock() - startTime > _stepBudgetMicroSeconds) {
+          _deferredStep = true;
+          _nDeferredSteps++;
+          checkBudget = false;
+        }
+        priority = unit->_priority;
+      }
+
+      if (!_deferredStep)
+        _stepUnit(unit);
+
+      // Deferred unit: keep track of its own time between steps, like decimated units.
+      else if (!unit->_deferred) {
+        unit->_deferred = true;
+        if (unit->_decimation == 1)
+          unit->_lastStepMicroSeconds = _microSeconds.micros32.base - _deltaTimeMicroSeconds;
+      }
+    }
+  }
+  _activeUnits.truncate(nActiveUnits);
+
+  // Propagate connections and look for events.
+  _endStep();
+}
+
+bool Engine::_unitStepDue(Unit* unit) {
+  // Decimated unit: only step once every N engine steps and keep track of its own time between steps.
+  if (unit->_decimation != 1) {
+    if (++unit->_decimationCounter < unit->_decimation)
+      return false;
+    unit->_decimationCounter = 0;
+    unit->_deltaTimeMicroSeconds = _microSeconds.micros32.base - unit->_lastStepMicroSeconds;
+    unit->_lastStepMicroSeconds = _microSeconds.micros32.base;
+  }
+
+  // Previously deferred unit: step over the time it skipped.
+  else if (unit->_deferred)
+    unit->_deltaTimeMicroSeconds = _microSeconds.micros32.base - unit->_lastStepMicroSeconds;
+  return true;
+}
+
+void Engine::_stepUnit(Unit* unit) {
+  if (!_unitStepDue(unit))
+    return;
+
+#if PQ_PROFILE
+  uint32_t startTime = micros();
+  unit->step();
+  unit->_stepProfile.add(micros() - startTime);
+#else
+  unit->step();
+#endif
+
+  // Back to engine time.
+  if (unit->_deferred)
+    unit->_deferred = false;
+}
+
+void Engine::_endStep() {
+  // Propagate values through connections (sources always come before their sinks).
+  for (size_t i=0; i != _connections.size(); i++) {
+    Connection& connection = _connections[i];
+    if (connection.source)
+      connection.sink->put(connection.source->get());
   }
 
   // Look for events.
-  _eventManager.step();
+#if PQ_PROFILE
+  uint32_t startTime = micros();
+  _eventManager.step(_nSteps, _microSeconds.micros32.base);
+  _eventsProfile.add(micros() - startTime);
+#else
+  _eventManager.step(_nSteps, _microSeconds.micros32.base);
+#endif
+
+  // Step child engines.
+  if (_children.size())
+    _stepChildren();
 }
 
 bool Engine::timeStep() {
-  // Calculate true sample rate.
-  _updateGlobalMicroSeconds();
+  // Advance time: by a fixed amount in virtual clock mode, otherwise by reading the clock.
+  if (_virtualDeltaTimeMicroSeconds) {
+    _totalGlobalMicroSeconds.micros64 = _microSeconds.micros64 + _virtualDeltaTimeMicroSeconds;
+    _virtualTimeFraction += _virtualDeltaTimeFraction;
+    if (_virtualTimeFraction < _virtualDeltaTimeFraction) // carry
+      _totalGlobalMicroSeconds.micros64++;
+  }
+  else
+    _updateGlobalMicroSeconds();
 
-  // Compute inter-step time.
-  _deltaTimeMicroSeconds = _totalGlobalMicroSeconds.micros32.base - _microSeconds.micros32.base;
-  float trueSampleRate = (_deltaTimeMicroSeconds ? SECONDS_TO_MICROS / _deltaTimeMicroSeconds : PLAQUETTE_MAX_SAMPLE_RATE);
+  // Time of this step (current time unless catching up).
+  micro_seconds_t stepTime = _totalGlobalMicroSeconds;
 
   // If autoSampleRate is off: wait in order to synchronize seconds with real time.
-  if (!_autoSampleRate) {
+  if (!_autoSampleRate && !_virtualDeltaTimeMicroSeconds) {
+
+#if PQ_TIMING_STATS
+    // True iff this is the first call since last step.
+    bool firstPoll = (_stepState == STEP_INIT);
+#endif
 
     // Initilize step state.
     if (_stepState == STEP_INIT) {
-      // Target time = current time + 1/_targetSampleRate
-      _targetTime = _microSeconds;
-      _targetTime.micros32.base += _targetDeltaTimeMicroSeconds;
+      // Target time = previous target time + 1/_targetSampleRate
+      _targetTime = _nextTargetTime();
+      _targetTimeFraction += _targetDeltaTimeFraction;
 
       // Check for overflow.
-      if (_targetTime.micros32.base >= _microSeconds.micros32.base) { // if target time is in the future: no overflow.
+      if (_targetTime.micros32.overflows == _microSeconds.micros32.overflows) { // no overflow since last step
         _stepState = STEP_WAIT;
       }
       else { // overflow
-        _targetTime.micros32.overflows++;
         _stepState = STEP_WAIT_OVERFLOW;
       }
     }
@@ -730,17 +1480,38 @@ bool Engine::timeStep() {
 
     // Reset state.
     _stepState = STEP_INIT;
+
+#if PQ_TIMING_STATS
+    _updateTimingStats(firstPoll);
+#endif
+
+    // Catch-up mode: step at target time rather than current time, unless too far behind.
+    if (_maxCatchUpSteps) {
+      if (_totalGlobalMicroSeconds.micros64 - _targetTime.micros64 < _targetDeltaTimeMicroSeconds) { // on schedule
+        stepTime = _targetTime;
+        _catchUpCount = 0;
+      }
+      else if (_catchUpCount < _maxCatchUpSteps) { // behind by a full period or more: catch up
+        stepTime = _targetTime;
+        _catchUpCount++;
+        _nCatchUpSteps++;
+      }
+      else // give up: next target time will be resynced with current time
+        _catchUpCount = 0;
+    }
   }
 
-  // Update sample rate and current time to "true" / actual values.
-  _setSampleRate(trueSampleRate);
+  // Compute inter-step time.
+  _deltaTimeMicroSeconds = stepTime.micros32.base - _microSeconds.micros32.base;
+  _updateStableSampleRate();
 
-  // Calculate delta time in fixed point.
-  uint64_t deltaTimeMicroSeconds64 = (uint64_t)_deltaTimeMicroSeconds;
-  _deltaTimeSecondsTimesFixed32Max = ((deltaTimeMicroSeconds64 << 32) - deltaTimeMicroSeconds64) * MICROS_TO_SECONDS;
+  // Sample rate, period and delta time in fixed point will be computed from actual delta time on demand:
+  // this keeps the time step free of floating point operations.
+  _sampleRate = _samplePeriod = 0;
+  _deltaTimeSecondsTimesFixed32Max = -1;
 
-  // Sync reference time with global (true) time.
-  _microSeconds = _totalGlobalMicroSeconds;
+  // Sync reference time with global (true) time, or with target time when catching up.
+  _microSeconds = stepTime;
 
   // Increment step.
   _nSteps++;
@@ -753,6 +1524,16 @@ void Engine::begin() {
 }
 
 bool Engine::step() {
+  if (_stepTime()) {
+    // Do the pre-step.
+    preStep();
+    return true;
+  }
+  else
+    return false;
+}
+
+bool Engine::_stepTime() {
   // On first run: do a post-begin.
   if (_firstRun) { // the compiler should make this branching step effectively CPU-free
     postBegin();
@@ -760,21 +1541,49 @@ bool Engine::step() {
     return false;
   }
 
-  // Otherwise: do a step.
-  else if (timeStep()) { // timeStep() will return false if we need to wait due to restrictive sampleRate(float)
-    // Do the pre-step.
-    preStep();
-    return true;
-  }
+  // Otherwise: do a time step.
   else
-    return false;
+    return timeStep(); // timeStep() will return false if we need to wait due to restrictive sampleRate(float)
 }
 
-void Engine::_setSampleRate(float sampleRate) {
-  _sampleRate = max(sampleRate, FLT_MIN); // cannot be zero
-  _samplePeriod = 0; // set to zero to reset cache
+void Engine::_updateStableSampleRate() {
+  // First step: initialize.
+  if (!_stableDeltaTimeMicroSeconds) {
+    if (_deltaTimeMicroSeconds)
+      _setStableDeltaTime(_deltaTimeMicroSeconds);
+    return;
+  }
+
+  // Smooth time between steps (integer exponential moving average).
+  _smoothedDeltaTimeMicroSeconds += (int32_t)(_deltaTimeMicroSeconds - _smoothedDeltaTimeMicroSeconds) >> PLAQUETTE_STABLE_SAMPLE_RATE_SMOOTHING;
+
+  // Publish only significant changes.
+  uint32_t tolerance = _stableDeltaTimeMicroSeconds >> PLAQUETTE_STABLE_SAMPLE_RATE_TOLERANCE;
+  if (_smoothedDeltaTimeMicroSeconds > _stableDeltaTimeMicroSeconds + tolerance ||
+      _smoothedDeltaTimeMicroSeconds + tolerance < _stableDeltaTimeMicroSeconds) {
+    _stableDeltaTimeMicroSeconds = _smoothedDeltaTimeMicroSeconds;
+    _sampleRateVersion++;
+  }
+}
+
+micro_seconds_t Engine::_nextTargetTime() const {
+  micro_seconds_t targetTime = _targetTime;
+  targetTime.micros64 += _targetDeltaTimeMicroSeconds;
+
+  // Carry fractional part of period.
+  if (static_cast<uint32_t>(_targetTimeFraction + _targetDeltaTimeFraction) < _targetTimeFraction)
+    targetTime.micros64++;
+
+  // If previous step was late by more than one period, resync with it instead of trying to catch up.
+  if (targetTime.micros64 <= _microSeconds.micros64) {
+    targetTime = _microSeconds;
+    targetTime.micros64 += _targetDeltaTimeMicroSeconds;
+  }
+
+  return targetTime;
 }
 
+
 } // namespace pq
 
 #endif
@@ -17,33 +17,333 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "PqEvents.h"
+#include "StateArchive.h"
 
 namespace pq {
 
+EventTrace::EventTrace(Engine* engine, size_t capacity)
+  : _engine(engine), _records(capacity ? new Record[capacity] : NULL), _capacity(_records ? capacity : 0),
+    _head(0), _size(0), _nOverwritten(0) {}
+
+EventTrace::~EventTrace() {
+  delete[] _records;
+}
+
+void EventTrace::recordDispatch(Unit* unit, EventType eventType, unsigned long step) {
+  _record(RECORD_DISPATCH, static_cast<uint16_t>(unit->_engineIndex), eventType, step);
+}
+
+void EventTrace::_record(RecordType recordType, uint16_t unitIndex, EventType eventType, unsigned long step) {
+  if (!_capacity)
+    return;
+
+  // Buffer is full: overwrite oldest record.
+  size_t index = (_head + _size) % _capacity;
+  if (_size == _capacity) {
+    _head = (_head + 1) % _capacity;
+    _nOverwritten++;
+  }
+  else
+    _size++;
+
+  Record& record = _records[index];
+  record.microSeconds = static_cast<uint32_t>(_engine->_clock());
+  record.step = static_cast<uint32_t>(step);
+  record.unitIndex = unitIndex;
+  record.eventType = static_cast<uint8_t>(eventType);
+  record.recordType = static_cast<uint8_t>(recordType);
+}
+
+// Stores value in little-endian order.
+static uint8_t* putLittleEndian(uint8_t* bytes, uint32_t value, uint8_t nBytes) {
+  for (uint8_t i=0; i<nBytes; i++, value >>= 8)
+    *bytes++ = static_cast<uint8_t>(value);
+  return bytes;
+}
+
+bool EventTrace::dump(StateWriter& writer) const {
+  // Header.
+  uint8_t bytes[EVENT_TRACE_RECORD_SIZE];
+  uint8_t* data = bytes;
+  *data++ = 'P'; *data++ = 'Q'; *data++ = 'T'; *data++ = 'R';
+  *data++ = EVENT_TRACE_FORMAT_VERSION;
+  *data++ = EVENT_TRACE_RECORD_SIZE;
+  data = putLittleEndian(data, _size, 4);
+  writer.transfer(bytes, data - bytes);
+  data = putLittleEndian(bytes, _nOverwritten, 4);
+  writer.transfer(bytes, data - bytes);
+
+  // Records, oldest first.
+  for (size_t i=0; i<_size; i++) {
+    const Record& record = _records[(_head + i) % _capacity];
+    data = putLittleEndian(bytes, record.microSeconds, 4);
+    data = putLittleEndian(data, record.step, 4);
+    data = putLittleEndian(data, record.unitIndex, 2);
+    *data++ = record.eventType;
+    *data++ = record.recordType;
+    writer.transfer(bytes, EVENT_TRACE_RECORD_SIZE);
+  }
+
+  return writer.ok();
+}
+
+EventManager::EventManager()
+  : _listeners(), _pushedListeners(), _pendingEvents(),
+    _queue(NULL), _queueCapacity(0), _queueHead(0), _queueSize(0), _nQueueOverflows(0),
+    _dispatchedStep(0), _dispatchedMicroSeconds(0), _trace(NULL) {}
+
+EventManager::~EventManager() {
+  delete[] _queue;
+  delete _trace;
+}
+
 void EventManager::addListener(Unit* unit, EventCallback callback, EventType eventType) {
-  _listeners.add(Listener(unit, callback, eventType));
+  _addListener(Listener(unit, callback, eventType));
+}
+
+void EventManager::addListener(Unit* unit, EventContextCallback callback, void* context, EventType eventType) {
+  _addListener(Listener(unit, callback, context, eventType));
 }
 
-// void EventManager::removeListeners(Unit* unit, EventCallback callback, uint8_t eventType) {
-//   Listener toRemove(unit, callback, eventType);
-//   while (_listeners.removeItem(toRemove));
-// }
+void EventManager::_addListener(const Listener& listener) {
+  Unit* unit = listener.unit;
 
-void EventManager::clearListeners(Unit* unit) {
-  for (int i=(int)_listeners.size()-1; i>=0; i--) {
-    if (_listeners[i].unit == unit) {
-      _listeners.remove(i);
+  // Event is polled at each step.
+  if (!unit->raisesEvent(listener.eventType)) {
+    _listeners.add(listener);
+    return;
+  }
+
+  // Event is raised by unit: insert after other listeners of the same unit.
+  size_t index = _firstPushedListener(unit);
+  while (index < _pushedListeners.size() && _pushedListeners[index].unit == unit)
+    index++;
+  _pushedListeners.insert(index, listener);
+  unit->_listenedEvents |= (1 << listener.eventType);
+}
+
+size_t EventManager::removeListener(Unit* unit, EventCallback callback, EventType eventType) {
+  return _removeListener(Listener(unit, callback, eventType));
+}
+
+size_t EventManager::removeListener(Unit* unit, EventContextCallback callback, void* context, EventType eventType) {
+  return _removeListener(Listener(unit, callback, context, eventType));
+}
+
+size_t EventManager::_removeListener(const Listener& listener) {
+  Unit* unit = listener.unit;
+  EventType eventType = listener.eventType;
+  size_t nRemoved = _listeners.removeIf([&listener](const Listener& other) { return other == listener; }) +
+                    _pushedListeners.removeIf([&listener](const Listener& other) { return other == listener; });
+
+  // Stop raising events nobody listens to anymore.
+  size_t first = _firstPushedListener(unit);
+  bool stillListened = false;
+  for (size_t k=0; first + k < _pushedListeners.size() && _pushedListeners[first + k].unit == unit; k++) {
+    if (_pushedListeners[first + k].eventType == eventType) {
+      stillListened = true;
+      break;
     }
   }
+  if (!stillListened)
+    unit->_listenedEvents &= ~(1 << eventType);
+
+  return nRemoved;
+}
+
+void EventManager::raiseEvent(Unit* unit, EventType eventType) {
+  // Already raised since last step.
+  uint8_t mask = (1 << eventType);
+  if (unit->_raisedEvents & mask)
+    return;
+  unit->_raisedEvents |= mask;
+
+  PendingEvent event = { unit, eventType };
+  _pendingEvents.add(event);
+}
+
+void EventManager::clearListeners(Unit* unit) {
+  _listeners.removeIf([unit](const Listener& listener) { return listener.unit == unit; });
+  _pushedListeners.removeIf([unit](const Listener& listener) { return listener.unit == unit; });
+  unit->_listenedEvents = 0;
+  unit->_raisedEvents = 0;
+
+  // Cancel pending and queued events (unit might be about to be destroyed).
+  for (size_t i=0; i<_pendingEvents.size(); i++) {
+    if (_pendingEvents[i].unit == unit)
+      _pendingEvents[i].unit = NULL;
+  }
+  for (size_t i=0; i<_queueSize; i++) {
+    QueuedEvent& event = _queue[(_queueHead + i) % _queueCapacity];
+    if (event.unit == unit)
+      event.unit = NULL;
+  }
 }
 
-void EventManager::step() {
+void EventManager::step(unsigned long step, uint32_t microSeconds) {
+  _dispatchedStep = step;
+  _dispatchedMicroSeconds = microSeconds;
+
   for (int i=0; i<(int)_listeners.size(); i++) {
     Listener& listener = _listeners[i];
     if (listener.unit->eventTriggered(listener.eventType)) {
-      listener.callback();
+      if (_queue)
+        _enqueue(listener.unit, listener.eventType, step, microSeconds);
+      else
+        _call(listener);
+    }
+  }
+
+  // Dispatch raised events (including events raised by callbacks).
+  for (size_t i=0; i<_pendingEvents.size(); i++) {
+    PendingEvent event = _pendingEvents[i]; // copy: callbacks might raise events
+    if (event.unit) {
+      // Event can be raised again (eg. by a callback).
+      event.unit->_raisedEvents &= ~(1 << event.eventType);
+      if (_queue)
+        _enqueue(event.unit, event.eventType, step, microSeconds);
+      else
+        _dispatch(event.unit, event.eventType);
+    }
+  }
+  _pendingEvents.removeAll();
+}
+
+bool EventManager::enableQueue(size_t capacity) {
+  disableQueue();
+  if (capacity) {
+    _queue = new QueuedEvent[capacity];
+    if (!_queue)
+      return false;
+    _queueCapacity = capacity;
+  }
+  return true;
+}
+
+void EventManager::disableQueue() {
+  dispatchQueue(_queueSize);
+  delete[] _queue;
+  _queue = NULL;
+  _queueCapacity = _queueHead = _queueSize = 0;
+}
+
+bool EventManager::enableTrace(Engine* engine, size_t capacity) {
+  disableTrace();
+  _trace = new EventTrace(engine, capacity);
+  if (!_trace || !_trace->ok()) {
+    disableTrace();
+    return false;
+  }
+  return true;
+}
+
+void EventManager::disableTrace() {
+  delete _trace;
+  _trace = NULL;
+}
+
+size_t EventManager::dispatchQueue(size_t maxEvents) {
+  size_t nDispatched = 0;
+  while (_queueSize && nDispatched < maxEvents) {
+    _dispatchQueued();
+    nDispatched++;
+  }
+  return nDispatched;
+}
+
+void EventManager::_enqueue(Unit* unit, EventType eventType, unsigned long step, uint32_t microSeconds) {
+  // Coalesce with events recorded during the same step (most recent first).
+  for (size_t i=_queueSize; i>0; i--) {
+    QueuedEvent& event = _queue[(_queueHead + i - 1) % _queueCapacity];
+    if (event.step != step)
+      break;
+    if (event.unit == unit && event.eventType == eventType)
+      return;
+  }
+
+  // Queue is full: dispatch oldest event rather than losing it.
+  if (_queueSize == _queueCapacity) {
+    _nQueueOverflows++;
+    _dispatchQueued();
+
+    // Queue was disabled by a callback.
+    if (!_queue) {
+      _dispatchedStep = step;
+      _dispatchedMicroSeconds = microSeconds;
+      _dispatch(unit, eventType);
+      _dispatchPolled(unit, eventType);
+      return;
     }
   }
+
+  QueuedEvent& event = _queue[(_queueHead + _queueSize) % _queueCapacity];
+  event.unit = unit;
+  event.eventType = eventType;
+  event.step = step;
+  event.microSeconds = microSeconds;
+  _queueSize++;
+}
+
+void EventManager::_dispatchQueued() {
+  // Remove event before calling listeners, which might dispatch events themselves.
+  QueuedEvent event = _queue[_queueHead];
+  _queueHead = (_queueHead + 1) % _queueCapacity;
+  _queueSize--;
+
+  if (event.unit) {
+    _dispatchedStep = event.step;
+    _dispatchedMicroSeconds = event.microSeconds;
+    _dispatch(event.unit, event.eventType);
+    _dispatchPolled(event.unit, event.eventType);
+  }
+}
+
+void EventManager::_dispatchPolled(Unit* unit, EventType eventType) {
+  for (size_t i=0; i<_listeners.size(); i++) {
+    Listener& listener = _listeners[i];
+    if (listener.unit == unit && listener.eventType == eventType)
+      _call(listener);
+  }
+}
+
+void EventManager::_dispatch(Unit* unit, EventType eventType) {
+  size_t first = _firstPushedListener(unit);
+  for (size_t k=0; first + k < _pushedListeners.size() && _pushedListeners[first + k].unit == unit; k++) {
+    if (_pushedListeners[first + k].eventType == eventType) {
+      Listener listener = _pushedListeners[first + k]; // copy: callback might add or remove listeners
+      size_t nListeners = _pushedListeners.size();
+      _call(listener);
+
+      // Callback added or removed listeners: find listeners of unit and called listener again.
+      if (_pushedListeners.size() != nListeners) {
+        first = _firstPushedListener(unit);
+        size_t j = 0;
+        while (first + j < _pushedListeners.size() && _pushedListeners[first + j].unit == unit &&
+               !(_pushedListeners[first + j] == listener))
+          j++;
+
+        // Resume after called listener, or at the listener that took its place if it was removed.
+        if (first + j < _pushedListeners.size() && _pushedListeners[first + j].unit == unit)
+          k = j;
+        else
+          k--; // wraps around when k == 0: incremented back by the loop
+      }
+    }
+  }
+}
+
+size_t EventManager::_firstPushedListener(Unit* unit) {
+  // Binary search.
+  size_t low = 0;
+  size_t high = _pushedListeners.size();
+  while (low < high) {
+    size_t middle = (low + high) / 2;
+    if (_pushedListeners[middle].unit < unit)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low;
 }
 
 }
@@ -24,11 +24,30 @@
 
 namespace pq {
 
+class Engine;
 class Unit;
+class StateWriter;
+
+// Format version of dumped event traces.
+#define EVENT_TRACE_FORMAT_VERSION 1
+
+// Size of dumped event trace header and records (in bytes).
+#define EVENT_TRACE_HEADER_SIZE 14
+#define EVENT_TRACE_RECORD_SIZE 12
 
 /// Callback type for event listeners.
 typedef void (*EventCallback)();
 
+/// Callback type for event listeners receiving a user pointer (eg. the object handling the event).
+typedef void (*EventContextCallback)(void* context);
+
+/**
+ * Event callback calling a member function on the object passed as context, without any heap
+ * allocation. Example: unit.onBang(eventMethod<Blinker, &Blinker::toggle>, &blinker);
+ */
+template<class T, void (T::*method)()>
+void eventMethod(void* context) { (static_cast<T*>(context)->*method)(); }
+
 /// Event types.
 enum EventType {  
   EVENT_NONE,    // no event
@@ -40,42 +59,304 @@ enum EventType {
   EVENT_UPDATE,  // unit updated and ready to be read/used
 };
 
-/// Manages event listeners for Plaquette units.
+/**
+ * Records event dispatches in a fixed-size ring buffer, for measuring the latency between a step
+ * and the callbacks of its events (see Engine::eventTrace()). A record is added at the beginning of
+ * each step and each time a callback is called. When the buffer is full, the oldest records are
+ * overwritten.
+ *
+ * Dumped traces start with a header ("PQTR", format version, record size, number of records,
+ * number of overwritten records) followed by records, oldest first. Each record holds (in
+ * little-endian order): time in microseconds (32 bits), step number (32 bits), unit index in the
+ * engine (16 bits), event type (8 bits) and record type (8 bits). Traces can be decoded with
+ * extras/decode_event_trace.py.
+ *
+ * Limits: times are read directly from the engine's reference clock, so that latencies are real
+ * processing times: they ignore the virtual clock and time scale of the engine. Unit indices are
+ * positions in the engine's list of units, which is compacted when units are removed: indices of
+ * records taken before and after a removal may refer to different units.
+ */
+class EventTrace {
+public:
+  /// Record types.
+  enum RecordType {
+    RECORD_STEP,     // beginning of a step
+    RECORD_DISPATCH, // callback called
+  };
+
+  /**
+   * Constructor.
+   * @param engine the engine providing the reference clock
+   * @param capacity maximum number of records
+   */
+  EventTrace(Engine* engine, size_t capacity);
+  ~EventTrace();
+
+  /// Returns false if the buffer could not be allocated.
+  bool ok() const { return _records != NULL; }
+
+  /// Records the beginning of a step.
+  void recordStep(unsigned long step) { _record(RECORD_STEP, 0, EVENT_NONE, step); }
+
+  /// Records a callback called for an event that occurred at given step.
+  void recordDispatch(Unit* unit, EventType eventType, unsigned long step);
+
+  /// Returns number of records in the buffer.
+  size_t size() const { return _size; }
+
+  /// Returns maximum number of records.
+  size_t capacity() const { return _capacity; }
+
+  /// Returns number of records overwritten since last clear().
+  unsigned long nOverwritten() const { return _nOverwritten; }
+
+  /// Removes all records.
+  void clear() { _head = _size = 0; _nOverwritten = 0; }
+
+  /**
+   * Writes header and records, oldest first.
+   * @param writer where to write the trace (eg. StreamStateWriter, FileStateWriter)
+   * @return true on success
+   */
+  bool dump(StateWriter& writer) const;
+
+private:
+  // A trace record.
+  struct Record {
+    uint32_t microSeconds;
+    uint32_t step;
+    uint16_t unitIndex;
+    uint8_t eventType;
+    uint8_t recordType;
+  };
+
+  // Adds a record, overwriting oldest one if full.
+  void _record(RecordType recordType, uint16_t unitIndex, EventType eventType, unsigned long step);
+
+  // Engine providing the reference clock.
+  Engine* _engine;
+
+  // Ring buffer of records.
+  Record* _records;
+
+  // Maximum number of records.
+  size_t _capacity;
+
+  // Index of oldest record.
+  size_t _head;
+
+  // Number of records.
+  size_t _size;
+
+  // Number of overwritten records.
+  unsigned long _nOverwritten;
+};
+
+/**
+ * Manages event listeners for Plaquette units. Units that raise their own events (see
+ * Unit::raisesEvent()) push them into a queue of pending events, so that the event pass only
+ * costs in proportion to the events that fired. Other events are polled at each step.
+ */
 class EventManager {
 
 private:
-  // A listener is a tuple (unit, callback, eventType)
+  // A listener is a tuple (unit, callback, context, eventType)
   struct Listener {
     Unit* unit;
-    EventCallback callback;
+    union {
+      EventCallback callback;
+      EventContextCallback contextCallback;
+    };
+    void* context;
     EventType eventType;
+    bool hasContext;
 
-    Listener() : unit(NULL), callback(NULL), eventType(EVENT_NONE) {}
+    Listener() : unit(NULL), callback(NULL), context(NULL), eventType(EVENT_NONE), hasContext(false) {}
 
     Listener(Unit* unit, EventCallback callback, EventType eventType) : 
-      unit(unit), callback(callback), eventType(eventType) {
+      unit(unit), callback(callback), context(NULL), eventType(eventType), hasContext(false) {
+    }
+
+    Listener(Unit* unit, EventContextCallback callback, void* context, EventType eventType) :
+      unit(unit), contextCallback(callback), context(context), eventType(eventType), hasContext(true) {
+    }
+
+    // Calls the callback.
+    void call() const {
+      if (hasContext)
+        contextCallback(context);
+      else
+        callback();
     }
 
     bool operator==(const Listener& other) const {
       return unit == other.unit && 
-             callback == other.callback && 
+             hasContext == other.hasContext &&
+             (hasContext ? contextCallback == other.contextCallback && context == other.context :
+                           callback == other.callback) &&
              eventType == other.eventType;
     }
   };
+
+  // An event raised by a unit, waiting to be dispatched.
+  struct PendingEvent {
+    Unit* unit;
+    EventType eventType;
+  };
+
+  // An event recorded in the event queue.
+  struct QueuedEvent {
+    Unit* unit;
+    EventType eventType;
+    unsigned long step;
+    uint32_t microSeconds;
+  };
+
 public:
+  /// Constructor.
+  EventManager();
+  ~EventManager();
+
   /// Adds a listener to the event manager.
   void addListener(Unit* unit, EventCallback callback, EventType eventType);
-  // void removeListeners(Unit* unit, EventCallback callback, uint8_t eventType);
+
+  /// Adds a listener called with a user pointer to the event manager.
+  void addListener(Unit* unit, EventContextCallback callback, void* context, EventType eventType);
+
+  /// Removes all listeners of a unit matching a callback and event type. Returns number of listeners removed.
+  size_t removeListener(Unit* unit, EventCallback callback, EventType eventType);
+
+  /// Removes all listeners of a unit matching a callback, user pointer and event type. Returns number of listeners removed.
+  size_t removeListener(Unit* unit, EventContextCallback callback, void* context, EventType eventType);
 
   /// Clears all listeners for a given unit.
   void clearListeners(Unit* unit);
 
-  /// Performs a single step of the event manager.
-  void step();
+  /// Queues an event raised by a unit (once per step): its listeners will be called during next step().
+  void raiseEvent(Unit* unit, EventType eventType);
+
+  /**
+   * Performs a single step of the event manager: calls listeners of events that fired, or records
+   * the events in the event queue if enabled.
+   * @param step the current step number
+   * @param microSeconds the current reference time (in microseconds)
+   */
+  void step(unsigned long step, uint32_t microSeconds);
+
+  /**
+   * Enables the event queue: events are recorded with their step number and time instead of
+   * calling listeners during step(), and listeners are called when dispatchEvents() is called.
+   * Events of the same type from the same unit are recorded once per step. If the queue is
+   * full, the oldest event is dispatched immediately to make room.
+   * @param capacity maximum number of queued events
+   * @return false if the queue could not be allocated
+   */
+  bool enableQueue(size_t capacity);
+
+  /// Dispatches remaining queued events and disables the event queue.
+  void disableQueue();
+
+  /// Returns true iff the event queue is enabled.
+  bool hasQueue() const { return _queue != NULL; }
+
+  /**
+   * Calls listeners of queued events, oldest first.
+   * @param maxEvents maximum number of events to dispatch
+   * @return number of events dispatched
+   */
+  size_t dispatchQueue(size_t maxEvents);
+
+  /// Returns number of events in the event queue.
+  size_t nQueuedEvents() const { return _queueSize; }
+
+  /// Returns number of events that had to be dispatched during step() because the queue was full.
+  unsigned long nQueueOverflows() const { return _nQueueOverflows; }
+
+  /// Returns step number of the queued event being dispatched.
+  unsigned long queuedEventStep() const { return _dispatchedStep; }
+
+  /// Returns reference time of the queued event being dispatched (in microseconds).
+  uint32_t queuedEventMicroSeconds() const { return _dispatchedMicroSeconds; }
+
+  /**
+   * Enables the event trace, replacing any previous one.
+   * @param engine the engine providing the reference clock
+   * @param capacity maximum number of records
+   * @return false if the trace could not be allocated
+   */
+  bool enableTrace(Engine* engine, size_t capacity);
+
+  /// Disables and deletes the event trace.
+  void disableTrace();
+
+  /// Returns the event trace (NULL if disabled).
+  EventTrace* trace() const { return _trace; }
+
+  /// Records the beginning of a step in the event trace, if enabled.
+  void traceStep(unsigned long step) {
+    if (_trace)
+      _trace->recordStep(step);
+  }
 
 private:
-  // Contains all listeners.
+  // Records an event in the queue (unless already recorded this step).
+  void _enqueue(Unit* unit, EventType eventType, unsigned long step, uint32_t microSeconds);
+
+  // Removes oldest event from the queue and calls its listeners.
+  void _dispatchQueued();
+
+  // Calls polled listeners of an event.
+  void _dispatchPolled(Unit* unit, EventType eventType);
+
+  // Calls a listener, recording it in the event trace if enabled.
+  void _call(const Listener& listener) {
+    if (_trace)
+      _trace->recordDispatch(listener.unit, listener.eventType, _dispatchedStep);
+    listener.call();
+  }
+
+  // Adds a listener.
+  void _addListener(const Listener& listener);
+
+  // Removes all listeners equal to given listener.
+  size_t _removeListener(const Listener& listener);
+
+  // Calls listeners of an event raised by a unit.
+  void _dispatch(Unit* unit, EventType eventType);
+
+  // Returns index of first listener of unit in _pushedListeners (or its size if there is none).
+  size_t _firstPushedListener(Unit* unit);
+
+  // Listeners of events that are polled at each step.
   HybridArrayList<Listener, 4> _listeners;
+
+  // Listeners of events raised by units, sorted by unit.
+  HybridArrayList<Listener, 4> _pushedListeners;
+
+  // Events raised since last step.
+  HybridArrayList<PendingEvent, 4> _pendingEvents;
+
+  // Event queue (ring buffer, NULL if disabled).
+  QueuedEvent* _queue;
+
+  // Capacity of event queue.
+  size_t _queueCapacity;
+
+  // Index of oldest event in queue.
+  size_t _queueHead;
+
+  // Number of events in queue.
+  size_t _queueSize;
+
+  // Number of events dispatched during step() because queue was full.
+  unsigned long _nQueueOverflows;
+
+  // Step number and time of queued event being dispatched.
+  unsigned long _dispatchedStep;
+  uint32_t _dispatchedMicroSeconds;
+
+  // Event trace (NULL if disabled).
+  EventTrace* _trace;
 };
 }
 
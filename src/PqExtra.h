@@ -53,6 +53,11 @@
 #include "TriangleWave.h"
 #include "Wave.h"
 
+// Engines.
+#include "EngineExecutor.h"
+#include "StateArchive.h"
+#include "StaticEngine.h"
+
 // Servo motors.
 #include <PqServo.h>
 
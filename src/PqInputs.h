@@ -196,6 +196,11 @@ protected:
 
   virtual void begin();
   virtual void step();
+
+  /// Change events are raised by step().
+  virtual bool raisesEvent(EventType eventType) const {
+    return (_isChangeEvent(eventType) || DigitalSource::raisesEvent(eventType));
+  }
 };
 
 } // namespace pq
@@ -94,6 +94,11 @@ protected:
   virtual void step();
 
   virtual void _init();
+
+  /// Change events are raised by step().
+  virtual bool raisesEvent(EventType eventType) const {
+    return (_isChangeEvent(eventType) || DigitalSource::raisesEvent(eventType));
+  }
 };
 
 } // namespace pq
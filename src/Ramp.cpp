@@ -19,6 +19,7 @@
  */
 
 #include "Ramp.h"
+#include "StateArchive.h"
 #include "pq_map.h"
 #include "pq_time.h"
 
@@ -76,6 +77,7 @@ float Ramp::mapTo(float toLow, float toHigh) {
 
 void Ramp::easing(easing_function easing) {
   _easing = easing;
+  _wake();
 }
 
 void Ramp::mode(uint8_t mode) {
@@ -103,6 +105,7 @@ void Ramp::fromTo(float from, float to) {
     _from = from;
     _to   = to;
   }
+  _wake();
 }
 
 void Ramp::duration(float duration) {
@@ -111,6 +114,7 @@ void Ramp::duration(float duration) {
 #if PQ_OPTIMIZE_FOR_CPU
   _speed = durationToSpeed(_duration);
 #endif
+  _wake();
 }
 
 void Ramp::speed(float speed) {
@@ -123,6 +127,7 @@ void Ramp::speed(float speed) {
     speed
 #endif
   ) );
+  _wake();
 }
 
 float Ramp::speed() const {
@@ -188,6 +193,7 @@ void Ramp::step() {
   if (_finishedState == NOT_FINISHED) {
     if (isFinished()) {
       _finishedState = JUST_FINISHED;
+      _raiseEvent(EVENT_FINISH);
     }
   }
   else if (_finishedState == JUST_FINISHED) {
@@ -198,6 +204,10 @@ void Ramp::step() {
       _finishedState = NOT_FINISHED;
     }
   }
+
+  // Value will not change until restarted (or changed).
+  if ((!_isRunning || isFinished()) && _finishedState != JUST_FINISHED)
+    _sleep();
 }
 
 void Ramp::_durationOrSpeed(float durationOrSpeed) {
@@ -214,6 +224,7 @@ float Ramp::_durationOrSpeed() const {
 void Ramp::setTime(float time) {
   AbstractTimer::setTime(time);
   _valueNeedsUpdate = true;
+  _wake();
 }
 
 float Ramp::durationToSpeed(float duration) const
@@ -236,4 +247,23 @@ float Ramp::_time() const {
   return seconds();
 }
 
+void Ramp::_setRunning(bool isRunning) {
+  AbstractTimer::_setRunning(isRunning);
+  if (isRunning)
+    _wake();
+}
+
+void Ramp::serializeState(StateArchive& archive) {
+  archive.value(_from);
+  archive.value(_to);
+  _mode = archive.copy((uint8_t)_mode);
+  float durationOrSpeed = archive.copy(_durationOrSpeed());
+  _finishedState = archive.copy((uint8_t)_finishedState);
+  _serializeTime(archive);
+  if (archive.isLoading()) {
+    _durationOrSpeed(durationOrSpeed);
+    _valueNeedsUpdate = true;
+  }
+}
+
 }
@@ -146,6 +146,9 @@ public:
   /// Registers event callback on finish event.
   virtual void onFinish(EventCallback callback) { onEvent(callback, EVENT_FINISH); }
 
+  /// Registers event callback on finish event, called with a user pointer.
+  virtual void onFinish(EventContextCallback callback, void* context) { onEvent(callback, context, EVENT_FINISH); }
+
   /// Forces current time (in seconds).
   virtual void setTime(float time);
 
@@ -174,6 +177,7 @@ private:
 protected:
   virtual void begin();
   virtual void step();
+  virtual void serializeState(StateArchive& archive);
 
   /// Returns true iff an event of a certain type has been triggered.
   virtual bool eventTriggered(EventType eventType) {
@@ -183,6 +187,11 @@ protected:
     }
   }
 
+  /// Finish events are raised by step().
+  virtual bool raisesEvent(EventType eventType) const {
+    return (eventType == EVENT_FINISH || Unit::raisesEvent(eventType));
+  }
+
   // Sets duration or speed (depending on current mode).
   void _durationOrSpeed(float durationOrSpeed);
   float _durationOrSpeed() const;
@@ -190,6 +199,9 @@ protected:
   // Returns current absolute time (in seconds).
   virtual float _time() const;
 
+  // Sets running state.
+  virtual void _setRunning(bool isRunning);
+
   // The starting point.
   float _from;
 
@@ -22,6 +22,7 @@
  */
 
 #include "RobustScaler.h"
+#include "StateArchive.h"
 #include "pq_moving_average.h"
 
 namespace pq {
@@ -262,4 +263,12 @@ void RobustScaler::step() {
 
 }
 
+void RobustScaler::serializeState(StateArchive& archive) {
+  MovingFilter::serializeState(archive);
+  archive.value(_lowQuantile);
+  archive.value(_highQuantile);
+  _stdDev.serializeState(archive);
+  archive.value(_currentStdDevStep);
+}
+
 }
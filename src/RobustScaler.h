@@ -104,6 +104,7 @@ public:
 
 protected:
   virtual void step();
+  virtual void serializeState(StateArchive& archive);
 
   // Internal quantile update (Robbins–Monro).
   inline void _updateQuantile(float& q, float level, float eta, float x);
@@ -21,6 +21,7 @@
 #include "MovingAverage.h"
 #include "pq_moving_average.h"
 #include "Smoother.h"
+#include "StateArchive.h"
 
 namespace pq {
 
@@ -113,4 +114,9 @@ void Smoother::step() {
 
 }
 
+void Smoother::serializeState(StateArchive& archive) {
+  MovingFilter::serializeState(archive);
+  archive.value(_currentValueStep);
+}
+
 }
@@ -64,6 +64,7 @@ public:
 
 protected:
   virtual void step();
+  virtual void serializeState(StateArchive& archive);
 
   // Variables used to compute current value average during a step (in case of multiple calls to put()).
   float _currentValueStep;
@@ -0,0 +1,89 @@
+/*
+ * StateArchive.cpp
+ *
+ * (c) 2025 Sofian Audry        :: info(@)sofianaudry(.)com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StateArchive.h"
+
+namespace pq {
+
+bool StateReader::skip(size_t size) {
+  uint8_t buffer[16];
+  while (size) {
+    size_t chunk = min(size, sizeof(buffer));
+    if (!transfer(buffer, chunk))
+      return false;
+    size -= chunk;
+  }
+  return true;
+}
+
+bool StreamStateWriter::_write(const void* data, size_t size) {
+  return (_stream->write(static_cast<const uint8_t*>(data), size) == size);
+}
+
+bool StreamStateReader::_read(void* data, size_t size) {
+  return (_stream->readBytes(static_cast<char*>(data), size) == size);
+}
+
+bool BufferStateWriter::_write(const void* data, size_t size) {
+  if (_size + size > _capacity)
+    return false;
+  memcpy(_buffer + _size, data, size);
+  _size += size;
+  return true;
+}
+
+bool BufferStateReader::_read(void* data, size_t size) {
+  if (_position + size > _size)
+    return false;
+  memcpy(data, _buffer + _position, size);
+  _position += size;
+  return true;
+}
+
+#if defined(EPOXY_DUINO)
+FileStateWriter::FileStateWriter(const char* path) : _file(fopen(path, "wb")) {
+  if (!_file)
+    _fail();
+}
+
+FileStateWriter::~FileStateWriter() {
+  if (_file)
+    fclose(_file);
+}
+
+bool FileStateWriter::_write(const void* data, size_t size) {
+  return (fwrite(data, 1, size, _file) == size);
+}
+
+FileStateReader::FileStateReader(const char* path) : _file(fopen(path, "rb")) {
+  if (!_file)
+    _fail();
+}
+
+FileStateReader::~FileStateReader() {
+  if (_file)
+    fclose(_file);
+}
+
+bool FileStateReader::_read(void* data, size_t size) {
+  return (fread(data, 1, size, _file) == size);
+}
+#endif
+
+} // namespace pq
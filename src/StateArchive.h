@@ -0,0 +1,231 @@
+/*
+ * StateArchive.h
+ *
+ * (c) 2025 Sofian Audry        :: info(@)sofianaudry(.)com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PQ_STATE_ARCHIVE_H_
+#define PQ_STATE_ARCHIVE_H_
+
+#include "PqCore.h"
+
+#if defined(EPOXY_DUINO)
+#include <stdio.h>
+#endif
+
+namespace pq {
+
+/**
+ * Saves or loads the state of units in a compact binary form (see Engine::saveState() and
+ * Engine::loadState()). Units describe their state once in Unit::serializeState(), using the
+ * same calls for saving and loading.
+ *
+ * The binary format is specific to the architecture: state should be restored by the same
+ * program running on the same kind of board.
+ */
+class StateArchive {
+public:
+  virtual ~StateArchive() {}
+
+  /// Returns true when loading state, false when saving state.
+  bool isLoading() const { return _loading; }
+
+  /// Returns false if an error occurred (eg. end of data or buffer full).
+  bool ok() const { return _ok; }
+
+  /**
+   * Saves or loads raw data.
+   * @param data the data (read when saving, written when loading)
+   * @param size the size of data in bytes
+   * @return true on success
+   */
+  bool transfer(void* data, size_t size) {
+    if (_ok)
+      _ok = (_loading ? _read(data, size) : _write(data, size));
+    return _ok;
+  }
+
+  /// Saves or loads a value (read when saving, written when loading).
+  template<typename T>
+  bool value(T& value) { return transfer(&value, sizeof(T)); }
+
+  /// Saves a value, or loads it if loading (useful for bit fields and values with setters).
+  template<typename T>
+  T copy(T value) { transfer(&value, sizeof(T)); return value; }
+
+protected:
+  StateArchive(bool loading) : _loading(loading), _ok(true) {}
+
+  // Writes data. Returns false on error.
+  virtual bool _write(const void* data, size_t size) { return false; }
+
+  // Reads data. Returns false on error.
+  virtual bool _read(void* data, size_t size) { return false; }
+
+  // Marks archive as invalid.
+  void _fail() { _ok = false; }
+
+private:
+  // True iff loading.
+  bool _loading;
+
+  // False if an error occurred.
+  bool _ok;
+};
+
+/// Base class for archives saving state.
+class StateWriter : public StateArchive {
+protected:
+  StateWriter() : StateArchive(false) {}
+};
+
+/// Base class for archives loading state.
+class StateReader : public StateArchive {
+public:
+  /// Skips data.
+  bool skip(size_t size);
+
+protected:
+  StateReader() : StateArchive(true) {}
+};
+
+/// Counts the number of bytes of saved state without writing it.
+class StateSizeCounter : public StateWriter {
+public:
+  StateSizeCounter() : _size(0) {}
+
+  /// Returns number of bytes counted.
+  size_t size() const { return _size; }
+
+protected:
+  virtual bool _write(const void* data, size_t size) { _size += size; return true; }
+
+  // Number of bytes counted.
+  size_t _size;
+};
+
+/// Saves state to a stream (eg. Serial, an SD card file).
+class StreamStateWriter : public StateWriter {
+public:
+  /// Constructor.
+  StreamStateWriter(Print& stream) : _stream(&stream) {}
+
+protected:
+  virtual bool _write(const void* data, size_t size);
+
+  // The stream.
+  Print* _stream;
+};
+
+/// Loads state from a stream (eg. Serial, an SD card file).
+class StreamStateReader : public StateReader {
+public:
+  /// Constructor.
+  StreamStateReader(Stream& stream) : _stream(&stream) {}
+
+protected:
+  virtual bool _read(void* data, size_t size);
+
+  // The stream.
+  Stream* _stream;
+};
+
+/// Saves state to a memory buffer (eg. to copy to EEPROM).
+class BufferStateWriter : public StateWriter {
+public:
+  /**
+   * Constructor.
+   * @param buffer the buffer
+   * @param capacity the size of the buffer (in bytes)
+   */
+  BufferStateWriter(uint8_t* buffer, size_t capacity) : _buffer(buffer), _capacity(capacity), _size(0) {}
+
+  /// Returns number of bytes written.
+  size_t size() const { return _size; }
+
+protected:
+  virtual bool _write(const void* data, size_t size);
+
+  // The buffer.
+  uint8_t* _buffer;
+
+  // Size of buffer.
+  size_t _capacity;
+
+  // Number of bytes written.
+  size_t _size;
+};
+
+/// Loads state from a memory buffer.
+class BufferStateReader : public StateReader {
+public:
+  /**
+   * Constructor.
+   * @param buffer the buffer
+   * @param size the number of bytes in the buffer
+   */
+  BufferStateReader(const uint8_t* buffer, size_t size) : _buffer(buffer), _size(size), _position(0) {}
+
+protected:
+  virtual bool _read(void* data, size_t size);
+
+  // The buffer.
+  const uint8_t* _buffer;
+
+  // Number of bytes in buffer.
+  size_t _size;
+
+  // Number of bytes read.
+  size_t _position;
+};
+
+#if defined(EPOXY_DUINO)
+/// Saves state to a file (host builds only).
+class FileStateWriter : public StateWriter {
+public:
+  /// Constructor. Opens file for writing.
+  FileStateWriter(const char* path);
+
+  /// Destructor. Closes file.
+  virtual ~FileStateWriter();
+
+protected:
+  virtual bool _write(const void* data, size_t size);
+
+  // The file.
+  FILE* _file;
+};
+
+/// Loads state from a file (host builds only).
+class FileStateReader : public StateReader {
+public:
+  /// Constructor. Opens file for reading.
+  FileStateReader(const char* path);
+
+  /// Destructor. Closes file.
+  virtual ~FileStateReader();
+
+protected:
+  virtual bool _read(void* data, size_t size);
+
+  // The file.
+  FILE* _file;
+};
+#endif
+
+} // namespace pq
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * StaticEngine.h
+ *
+ * (c) 2025 Sofian Audry        :: info(@)sofianaudry(.)com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PQ_STATIC_ENGINE_H_
+#define PQ_STATIC_ENGINE_H_
+
+#include "PqCore.h"
+
+namespace pq {
+
+// Internal use. Unit stored by value in a static engine: its step() is called without virtual dispatch.
+template<typename T>
+struct StaticUnit final : public T {
+  StaticUnit(Engine& engine) : T(engine) {}
+
+  // Calls T::step() directly.
+  inline void staticStep() { this->T::step(); }
+};
+
+// Internal use. Recursive list holding units by value.
+template<typename... Units>
+struct StaticUnitList {
+  StaticUnitList(Engine& engine) {}
+
+  template<typename Function>
+  inline void forEach(Function& function) {}
+};
+
+template<typename T, typename... Rest>
+struct StaticUnitList<T, Rest...> {
+  StaticUnit<T> head;
+  StaticUnitList<Rest...> tail;
+
+  StaticUnitList(Engine& engine) : head(engine), tail(engine) {}
+
+  template<typename Function>
+  inline void forEach(Function& function) {
+    function(head);
+    tail.forEach(function);
+  }
+};
+
+// Internal use. Gives access to unit at a given position in a StaticUnitList.
+template<size_t I, typename... Units>
+struct StaticUnitAt;
+
+template<typename T, typename... Rest>
+struct StaticUnitAt<0, T, Rest...> {
+  typedef T type;
+  static type& get(StaticUnitList<T, Rest...>& list) { return list.head; }
+};
+
+template<size_t I, typename T, typename... Rest>
+struct StaticUnitAt<I, T, Rest...> {
+  typedef typename StaticUnitAt<I-1, Rest...>::type type;
+  static type& get(StaticUnitList<T, Rest...>& list) { return StaticUnitAt<I-1, Rest...>::get(list.tail); }
+};
+
+/**
+ * An engine whose units are fixed at compile time and stored by value.
+ *
+ * Units are stepped in the order of the template parameters, through direct calls to each unit's
+ * step() resolved at compile time (no virtual dispatch). Otherwise it behaves as a regular Engine
+ * (time, sample rate, events, connections), including when stepped through an Engine reference
+ * (eg. as a child engine or in an EngineExecutor). Unit priorities and the step budget do not apply.
+ *
+ * Each unit type must be constructible from an engine reference. Use a subclass to bind other
+ * constructor arguments:
+ *
+ * @code
+ * struct Led : AnalogOut { Led(Engine& engine) : AnalogOut(9, engine) {} };
+ * StaticEngine<Metronome, Ramp, Led> engine;
+ * @endcode
+ *
+ * Only the units listed as template parameters are stepped by step(): other units should not be
+ * added to a static engine.
+ */
+template<typename... Units>
+class StaticEngine : public Engine {
+public:
+  /// Constructor.
+  StaticEngine() : Engine(), _staticUnits(*this) {
+    _stepUnitsFunction = _stepStaticUnits;
+  }
+
+  /// Returns unit at position I in template parameters.
+  template<size_t I>
+  typename StaticUnitAt<I, Units...>::type& unit() { return StaticUnitAt<I, Units...>::get(_staticUnits); }
+
+  /// Returns number of units listed in template parameters.
+  static size_t nStaticUnits() { return sizeof...(Units); }
+
+private:
+  // Function object used to step units.
+  struct UnitStepper {
+    StaticEngine* engine;
+
+    template<typename T>
+    inline void operator()(StaticUnit<T>& unit) {
+      if (!unit.isDormant())
+        engine->_stepStaticUnit(unit);
+    }
+  };
+
+  // Steps units in order (called by Engine::preStep()).
+  static void _stepStaticUnits(Engine& engine) {
+    StaticEngine& self = static_cast<StaticEngine&>(engine);
+    UnitStepper stepper = { &self };
+    self._staticUnits.forEach(stepper);
+  }
+
+  // The units.
+  StaticUnitList<Units...> _staticUnits;
+};
+
+} // namespace pq
+
+#endif
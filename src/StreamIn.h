@@ -50,6 +50,9 @@ public:
   /// Registers event callback on finish event.
   virtual void onUpdate(EventCallback callback) { onEvent(callback, EVENT_UPDATE); }
 
+  /// Registers event callback on update event, called with a user pointer.
+  virtual void onUpdate(EventContextCallback callback, void* context) { onEvent(callback, context, EVENT_UPDATE); }
+
 protected:
   // Core Plaquette methods.
   virtual void begin();
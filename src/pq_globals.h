@@ -26,11 +26,12 @@
 // Global constants.
 // ----------------------------------------------------------------------------
 
-// Max. components that can be added. Can be pre-defined. Notice that the use of a
-// hybrid array list requires a fixed size at compile time but the size will automatically be
-// adjusted at runtime if necessary using dynamically-allocated memory.
+// Number of units each engine can hold without dynamic memory allocation. Can be pre-defined.
+// Each engine stores this many unit pointers inline, so every engine (including the main one)
+// costs PLAQUETTE_MAX_UNITS * sizeof(Unit*) bytes of static RAM. Engines with more units grow
+// their list at runtime using dynamically-allocated memory.
 #ifndef PLAQUETTE_MAX_UNITS
-#define PLAQUETTE_MAX_UNITS 32
+#define PLAQUETTE_MAX_UNITS 8
 #endif
 
 // Serial.
@@ -53,6 +54,16 @@
 // Sample rate.
 #define PLAQUETTE_MAX_SAMPLE_RATE FLT_MAX
 
+// Smoothing applied to time between steps to compute the stable sample rate (alpha = 1/2^n).
+#ifndef PLAQUETTE_STABLE_SAMPLE_RATE_SMOOTHING
+#define PLAQUETTE_STABLE_SAMPLE_RATE_SMOOTHING 3
+#endif
+
+// Relative change of the smoothed time between steps that updates the stable sample rate (1/2^n).
+#ifndef PLAQUETTE_STABLE_SAMPLE_RATE_TOLERANCE
+#define PLAQUETTE_STABLE_SAMPLE_RATE_TOLERANCE 5
+#endif
+
 #define INFINITE_TIME_WINDOW (-1)
 #define NO_TIME_WINDOW       0
 
@@ -138,4 +149,37 @@
 
 #endif
 
+// ----------------------------------------------------------------------------
+// Multithreading.
+// ----------------------------------------------------------------------------
+
+// Support for running engines on multiple threads (host builds only, see EngineExecutor).
+#ifndef PQ_HAS_THREADS
+#if defined(EPOXY_DUINO)
+#define PQ_HAS_THREADS 1
+#else
+#define PQ_HAS_THREADS 0
+#endif
+#endif
+
+// ----------------------------------------------------------------------------
+// Profiling.
+// ----------------------------------------------------------------------------
+
+// Enable per-unit profiling of engine steps (see Engine::printProfile()).
+#ifndef PQ_PROFILE
+#define PQ_PROFILE 0
+#endif
+
+// Number of bins in profiling histograms (bin b counts durations in [2^(b-1), 2^b) us).
+#ifndef PQ_PROFILE_HISTOGRAM_BINS
+#define PQ_PROFILE_HISTOGRAM_BINS 16
+#endif
+
+// Enable deadline and jitter statistics in fixed sample rate mode (see Engine::nOverruns()).
+// Disabled by default on low-RAM chips.
+#ifndef PQ_TIMING_STATS
+#define PQ_TIMING_STATS PQ_OPTIMIZE_FOR_CPU
+#endif
+
 #endif
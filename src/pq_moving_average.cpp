@@ -65,4 +65,33 @@ float movingAverageAlpha(float sampleRate, float smoothTime, unsigned int nSampl
   }
 }
 
+void MovingAverageAlpha::_update(float sampleRate, float timeWindow, uint16_t sampleRateVersion) {
+  _timeWindow = timeWindow;
+  _sampleRateVersion = sampleRateVersion;
+
+  // Same terms as movingAverageAlpha().
+  if (timeWindow >= 0)
+    _nSamplesTarget = timeWindow * sampleRate;
+  else
+    _nSamplesTarget = (unsigned int)(sampleRate * PRE_INITIALIZED_STABILIZATION_TIME);
+  _alphaTarget = movingAverageExponentialAlpha(_nSamplesTarget);
+}
+
+float MovingAverageAlpha::alpha(unsigned int nSamples, bool preInitialized) const {
+  // Finite time window.
+  if (_timeWindow >= 0) {
+    if (preInitialized)
+      return _alphaTarget;
+    else {
+      // Non-moving average for the first values (see movingAverageAlpha()).
+      float nSamplesPlusOne = nSamples + 1.0f;
+      return (nSamplesPlusOne < _nSamplesTarget ? 1.0f / nSamplesPlusOne : _alphaTarget);
+    }
+  }
+
+  // Infinite time window.
+  else
+    return (preInitialized && nSamples <= _nSamplesTarget ? _alphaTarget : movingAverageSimpleAlpha(nSamples));
+}
+
 }
@@ -79,6 +79,45 @@ inline float movingAverageSimpleAlpha(float nSamples) {
 /// Returns the alpha value computed from given sample rate, time window, and number of samples.
 float movingAverageAlpha(float sampleRate, float timeWindow=INFINITE_TIME_WINDOW, unsigned int nSamples=UINT_MAX, bool preInitialized=false);
 
+/**
+ * Precomputes the terms of movingAverageAlpha() that depend on sample rate and time window, so that
+ * alpha values can be obtained cheaply at every step. Terms are recomputed only when the time window
+ * or the unit's stable sample rate (see Unit::stableSampleRate()) change.
+ */
+class MovingAverageAlpha {
+public:
+  MovingAverageAlpha() : _timeWindow(-2), _nSamplesTarget(0), _alphaTarget(1), _sampleRateVersion(0) {}
+
+  /**
+   * Recomputes terms if needed.
+   * @param unit the unit whose stable sample rate is used
+   * @param timeWindow the time window (in seconds)
+   */
+  void update(const Unit& unit, float timeWindow) {
+    if (timeWindow != _timeWindow || unit.sampleRateVersion() != _sampleRateVersion)
+      _update(unit.stableSampleRate(), timeWindow, unit.sampleRateVersion());
+  }
+
+  /// Returns the alpha value; equivalent to movingAverageAlpha(sampleRate, timeWindow, nSamples, preInitialized).
+  float alpha(unsigned int nSamples=UINT_MAX, bool preInitialized=false) const;
+
+private:
+  // Recomputes terms.
+  void _update(float sampleRate, float timeWindow, uint16_t sampleRateVersion);
+
+  // Time window for which terms were computed (-2 if not computed yet).
+  float _timeWindow;
+
+  // Approximative number of samples in time window (or in stabilization time if infinite time window).
+  float _nSamplesTarget;
+
+  // Alpha value corresponding to _nSamplesTarget.
+  float _alphaTarget;
+
+  // Sample rate version for which terms were computed.
+  uint16_t _sampleRateVersion;
+};
+
 }
 
 #endif
@@ -57,6 +57,43 @@ bool phase32UpdateFixed32(q0_32u_t& phase32, float frequency, float deltaTimeSec
 }
 
 
+// Phase increment per microsecond at 1 Hz (in 1/2^32 of period).
+#define PHASE32_PER_MICROSECOND_HZ 4294.967296f
+
+void frequencyToPhase32PerMicros(float frequency, uint32_t& mantissa, uint8_t& shift) {
+  float increment = frequency * PHASE32_PER_MICROSECOND_HZ;
+
+  // More than a full period per microsecond (including infinite frequency).
+  if (!(increment < 4294967295.0f)) {
+    mantissa = FIXED_32_MAX;
+    shift = 0;
+    return;
+  }
+
+  // Normalize mantissa to 32 bits for best precision.
+  shift = 0;
+  while (increment < 2147483648.0f && shift < 63) {
+    increment *= 2;
+    shift++;
+  }
+  mantissa = static_cast<uint32_t>(increment + 0.5f);
+}
+
+bool phase32UpdateMicros(q0_32u_t& phase32, uint32_t deltaTimeMicroSeconds, uint32_t mantissa, uint8_t shift, bool forward) {
+  uint64_t product = static_cast<uint64_t>(deltaTimeMicroSeconds) * mantissa;
+  uint64_t increment;
+  if (shift == 0)
+    increment = product;
+  else {
+    product += static_cast<uint64_t>(1) << (shift - 1); // round
+    // Shifting the upper word separately avoids a 64-bit shift loop on 8-bit boards.
+    increment = (shift >= 32 ? static_cast<uint32_t>(product >> 32) >> (shift - 32) : product >> shift);
+  }
+
+  // Saturate to a single overflow per step.
+  return _phase32Update(phase32, increment > FIXED_32_MAX ? FIXED_32_MAX : static_cast<q0_32u_t>(increment), forward);
+}
+
 /// Computes new phase time for oscillators and returns when phase time overflows or underflows.
 bool phase32Update(q0_32u_t& phase32, float period, float sampleRate, bool forward) {
   // Premultiply period.
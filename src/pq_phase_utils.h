@@ -93,6 +93,19 @@ bool phase32UpdateFixed32(q0_32u_t& phase32, float frequency, float deltaTimeSec
 /// Computes new phase time for oscillators and returns true when phase time overflows.
 bool phase32Update(q0_32u_t& phase32, float period, float sampleRate, bool forward = true);
 
+/**
+ * Converts a frequency into a phase increment per microsecond, expressed as mantissa / 2^shift
+ * (in 1/2^32 of period), for use with phase32UpdateMicros().
+ * @param frequency the frequency (in Hz)
+ * @param mantissa the mantissa of the increment (output)
+ * @param shift the binary exponent of the increment (output)
+ */
+void frequencyToPhase32PerMicros(float frequency, uint32_t& mantissa, uint8_t& shift);
+
+/// Computes new phase time for oscillators in integer arithmetic and returns true when phase time overflows
+/// (uses increment computed by frequencyToPhase32PerMicros()).
+bool phase32UpdateMicros(q0_32u_t& phase32, uint32_t deltaTimeMicroSeconds, uint32_t mantissa, uint8_t shift, bool forward = true);
+
 }
 
 #endif
@@ -0,0 +1,63 @@
+/*
+ * pq_profile.cpp
+ *
+ * (c) 2025 Sofian Audry        :: info(@)sofianaudry(.)com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pq_profile.h"
+#include "pq_print.h"
+
+namespace pq {
+
+void StepProfile::reset() {
+  _totalMicroSeconds = 0;
+  _nSamples = 0;
+  _minMicroSeconds = UINT32_MAX;
+  _maxMicroSeconds = 0;
+  for (uint8_t i=0; i<PQ_PROFILE_HISTOGRAM_BINS; i++)
+    _histogram[i] = 0;
+}
+
+void StepProfile::add(uint32_t microSeconds) {
+  // Update statistics.
+  _totalMicroSeconds += microSeconds;
+  _nSamples++;
+  if (microSeconds < _minMicroSeconds) _minMicroSeconds = microSeconds;
+  if (microSeconds > _maxMicroSeconds) _maxMicroSeconds = microSeconds;
+
+  // Find histogram bin (ie. number of significant bits).
+  uint8_t bin = 0;
+  while (microSeconds && bin < PQ_PROFILE_HISTOGRAM_BINS-1) {
+    microSeconds >>= 1;
+    bin++;
+  }
+  _histogram[bin]++;
+}
+
+void StepProfile::print() const {
+  pq::print("n=");     pq::print((unsigned long)_nSamples);
+  pq::print(" total="); pq::print((double)_totalMicroSeconds, 0);
+  pq::print(" min=");  pq::print((unsigned long)minMicroSeconds());
+  pq::print(" mean="); pq::print(meanMicroSeconds(), 2);
+  pq::print(" max=");  pq::print((unsigned long)maxMicroSeconds());
+  pq::print(" hist=");
+  for (uint8_t i=0; i<PQ_PROFILE_HISTOGRAM_BINS; i++) {
+    if (i) pq::print(',');
+    pq::print((unsigned long)_histogram[i]);
+  }
+}
+
+} // namespace pq
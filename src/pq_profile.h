@@ -0,0 +1,92 @@
+/*
+ * pq_profile.h
+ *
+ * Timing statistics used by the engine profiler (see PQ_PROFILE) and deadline
+ * monitoring (see PQ_TIMING_STATS).
+ *
+ * (c) 2025 Sofian Audry        :: info(@)sofianaudry(.)com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PQ_PROFILE_H_
+#define PQ_PROFILE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "pq_globals.h"
+
+namespace pq {
+
+/**
+ * Accumulates execution time statistics (min, mean, max and a log2 histogram)
+ * over a series of measurements expressed in microseconds.
+ *
+ * Histogram bin 0 counts measurements of 0 us, and bin b > 0 counts measurements
+ * in [2^(b-1), 2^b) us. The last bin also counts all larger measurements.
+ */
+class StepProfile {
+public:
+  /// Constructor.
+  StepProfile() { reset(); }
+
+  /// Clears all statistics.
+  void reset();
+
+  /// Adds a measurement (in microseconds).
+  void add(uint32_t microSeconds);
+
+  /// Returns number of measurements.
+  uint32_t nSamples() const { return _nSamples; }
+
+  /// Returns minimum measurement (in microseconds).
+  uint32_t minMicroSeconds() const { return _nSamples ? _minMicroSeconds : 0; }
+
+  /// Returns maximum measurement (in microseconds).
+  uint32_t maxMicroSeconds() const { return _maxMicroSeconds; }
+
+  /// Returns average measurement (in microseconds).
+  float meanMicroSeconds() const { return _nSamples ? (float)_totalMicroSeconds / _nSamples : 0.0f; }
+
+  /// Returns sum of all measurements (in microseconds).
+  uint64_t totalMicroSeconds() const { return _totalMicroSeconds; }
+
+  /// Returns number of measurements in histogram bin.
+  uint32_t histogram(uint8_t bin) const { return (bin < PQ_PROFILE_HISTOGRAM_BINS ? _histogram[bin] : 0); }
+
+  /// Returns number of histogram bins.
+  static uint8_t nHistogramBins() { return PQ_PROFILE_HISTOGRAM_BINS; }
+
+  /// Prints statistics on a single line using the console (see pq_print.h).
+  void print() const;
+
+private:
+  // Sum of all measurements.
+  uint64_t _totalMicroSeconds;
+
+  // Number of measurements.
+  uint32_t _nSamples;
+
+  // Extremum measurements.
+  uint32_t _minMicroSeconds;
+  uint32_t _maxMicroSeconds;
+
+  // Histogram counts.
+  uint32_t _histogram[PQ_PROFILE_HISTOGRAM_BINS];
+};
+
+} // namespace pq
+
+#endif
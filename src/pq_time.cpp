@@ -22,6 +22,10 @@
 
 #include "PqCore.h"
 
+#if defined(EPOXY_DUINO)
+#include <time.h>
+#endif
+
 namespace pq {
 
 uint64_t microSeconds(bool referenceTime) { return Plaquette.microSeconds(referenceTime); }
@@ -30,4 +34,12 @@ uint32_t milliSeconds(bool referenceTime) { return Plaquette.milliSeconds(refere
 
 float seconds(bool referenceTime) { return Plaquette.seconds(referenceTime); }
 
+#if defined(EPOXY_DUINO)
+uint64_t hostNanoSeconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * NANOS_PER_SECOND + now.tv_nsec;
+}
+#endif
+
 } // namespace pq
@@ -31,6 +31,7 @@ namespace pq {
 #define MICROS_PER_MILLIS    1000
 #define MILLIS_PER_SECOND    1000
 #define MICROS_PER_SECOND 1000000UL
+#define NANOS_PER_SECOND  1000000000UL
 
 #define SECONDS_PER_MINUTE     60
 #define SECONDS_PER_HOUR     3600
@@ -47,6 +48,9 @@ namespace pq {
 #define MILLIS_TO_SECONDS    1e-3f
 #define MICROS_TO_SECONDS    1e-6f
 
+// Seconds per microsecond, times 2^32 - 1 (used to convert time to fixed-point phase).
+#define MICROS_TO_SECONDS_TIMES_FIXED32_MAX 4294.967295f
+
 constexpr float BPM_TO_HZ = 1.0f / SECONDS_PER_MINUTE;
 #define HZ_TO_BPM 60.0f
 
@@ -91,6 +95,15 @@ uint32_t milliSeconds(bool referenceTime=true);
  */
 uint64_t microSeconds(bool referenceTime=true);
 
+#if defined(EPOXY_DUINO)
+/**
+ * Returns time of the host's monotonic clock in nanoseconds (host builds only). Can be used as a
+ * high-resolution reference clock: referenceClock(hostNanoSeconds, NANOS_PER_SECOND).
+ * @return the time in nanoseconds
+ */
+uint64_t hostNanoSeconds();
+#endif
+
 /**
  * Converts microseconds to milliseconds.
  * @param micros microseconds
@@ -105,6 +118,14 @@ inline uint32_t microsToMillis(uint64_t micros) { return micros / MICROS_PER_MIL
  */
 inline float microsToSeconds(uint64_t micros) { return micros * MICROS_TO_SECONDS; }
 
+/**
+ * Converts microseconds to seconds, expressed as a proportion of a 32-bit fixed-point unit
+ * (ie. seconds x (2^32 - 1)). Uses a single 32-bit to float conversion and multiplication.
+ * @param micros microseconds
+ * @return seconds x (2^32 - 1)
+ */
+inline float microsToSecondsTimesFixed32Max(uint32_t micros) { return micros * MICROS_TO_SECONDS_TIMES_FIXED32_MAX; }
+
 /**
  * Converts milliseconds to microseconds.
  * @param millis milliseconds
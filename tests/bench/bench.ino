@@ -0,0 +1,148 @@
+/**
+ * Benchmark of Plaquette units on host (EpoxyDuino).
+ *
+ * Builds engines containing 10, 100 and 1000 units of each type and measures the time taken
+ * by Engine::step() and by Unit::put(). Filters are fed by a wave through connections. Engines
+ * run on a virtual clock so that only the time spent in the library is measured.
+ *
+ * Results are printed in CSV format, one line per measure:
+ *   benchmark,unit,n_units,iterations,ns_per_iteration,ns_per_unit,iterations_per_second
+ */
+#include <Arduino.h>
+#include <PlaquetteLib.h>
+
+using namespace pq;
+
+// Minimum duration of each measure (in nanoseconds).
+#define BENCH_DURATION 100000000ULL
+
+// Number of iterations between two readings of the clock.
+#define BENCH_BATCH 16
+
+// Number of units of each type.
+const size_t BENCH_SIZES[] = { 10, 100, 1000 };
+#define N_BENCH_SIZES (sizeof(BENCH_SIZES) / sizeof(size_t))
+
+// Prints a result line.
+void printResult(const char* benchmark, const char* unitName, size_t nUnits, unsigned long nIterations, uint64_t elapsed) {
+  float nanosPerIteration = (float)elapsed / nIterations;
+  Serial.print(benchmark);
+  Serial.print(',');
+  Serial.print(unitName);
+  Serial.print(',');
+  Serial.print((unsigned long)nUnits);
+  Serial.print(',');
+  Serial.print(nIterations);
+  Serial.print(',');
+  Serial.print(nanosPerIteration, 1);
+  Serial.print(',');
+  Serial.print(nUnits ? nanosPerIteration / nUnits : nanosPerIteration, 2);
+  Serial.print(',');
+  Serial.println(1e9f / nanosPerIteration, 1);
+}
+
+// Steps engine repeatedly and prints result.
+void benchStep(Engine& engine, const char* unitName, size_t nUnits) {
+  unsigned long nIterations = 0;
+  uint64_t startTime = hostNanoSeconds();
+  uint64_t elapsed;
+  do {
+    for (int k=0; k<BENCH_BATCH; k++)
+      engine.step();
+    nIterations += BENCH_BATCH;
+    elapsed = hostNanoSeconds() - startTime;
+  } while (elapsed < BENCH_DURATION);
+
+  printResult("step", unitName, nUnits, nIterations, elapsed);
+}
+
+// Puts values into units repeatedly and prints result.
+template<class T>
+void benchPut(T** units, const char* unitName, size_t nUnits) {
+  unsigned long nIterations = 0;
+  float value = 0;
+  uint64_t startTime = hostNanoSeconds();
+  uint64_t elapsed;
+  do {
+    for (int k=0; k<BENCH_BATCH; k++) {
+      value = (value < 1 ? value + 0.01f : 0);
+      for (size_t i=0; i<nUnits; i++)
+        units[i]->put(value);
+    }
+    nIterations += BENCH_BATCH;
+    elapsed = hostNanoSeconds() - startTime;
+  } while (elapsed < BENCH_DURATION);
+
+  printResult("put", unitName, nUnits, nIterations, elapsed);
+}
+
+// Benchmarks one type of unit at all sizes.
+// - create: returns a new unit on given engine
+// - prepare: called on each unit after engine begins (eg. to start timers)
+// - isFilter: if true, units are fed by a wave and put() is also measured
+template<class T>
+void benchUnit(const char* unitName, T* (*create)(Engine&), void (*prepare)(T*), bool isFilter) {
+  for (size_t s=0; s<N_BENCH_SIZES; s++) {
+    size_t nUnits = BENCH_SIZES[s];
+    Engine engine;
+    Wave* source = (isFilter ? new Wave(SINE, 1.0f, engine) : 0);
+    T** units = new T*[nUnits];
+    for (size_t i=0; i<nUnits; i++) {
+      units[i] = create(engine);
+      if (source)
+        engine.connect(*source, *units[i]);
+    }
+
+    engine.virtualClock(1000);
+    engine.begin();
+    if (prepare) {
+      for (size_t i=0; i<nUnits; i++)
+        prepare(units[i]);
+    }
+    engine.step();
+
+    benchStep(engine, unitName, nUnits);
+    if (isFilter)
+      benchPut(units, unitName, nUnits);
+
+    for (size_t i=0; i<nUnits; i++)
+      delete units[i];
+    delete[] units;
+    delete source;
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("benchmark,unit,n_units,iterations,ns_per_iteration,ns_per_unit,iterations_per_second");
+
+  // Engine overhead.
+  {
+    Engine engine;
+    engine.virtualClock(1000);
+    engine.begin();
+    benchStep(engine, "Engine", 0);
+  }
+
+  // Generators.
+  benchUnit<Wave>("Wave(SINE)", [](Engine& e) { return new Wave(SINE, 1.0f, e); }, 0, false);
+  benchUnit<Wave>("Wave(SQUARE)", [](Engine& e) { return new Wave(SQUARE, 1.0f, e); }, 0, false);
+  benchUnit<Wave>("Wave(TRIANGLE)", [](Engine& e) { return new Wave(TRIANGLE, 1.0f, e); }, 0, false);
+
+  // Timing.
+  benchUnit<Metronome>("Metronome", [](Engine& e) { return new Metronome(0.1f, e); }, 0, false);
+  benchUnit<Alarm>("Alarm", [](Engine& e) { return new Alarm(1e6f, e); }, [](Alarm* u) { u->start(); }, false);
+  benchUnit<Chronometer>("Chronometer", [](Engine& e) { return new Chronometer(e); }, [](Chronometer* u) { u->start(); }, false);
+  benchUnit<Ramp>("Ramp", [](Engine& e) { return new Ramp(1e6f, e); }, [](Ramp* u) { u->start(); }, false);
+
+  // Filters.
+  benchUnit<Smoother>("Smoother", [](Engine& e) { return new Smoother(1.0f, e); }, 0, true);
+  benchUnit<MinMaxScaler>("MinMaxScaler", [](Engine& e) { return new MinMaxScaler(10.0f, e); }, 0, true);
+  benchUnit<Normalizer>("Normalizer", [](Engine& e) { return new Normalizer(10.0f, e); }, 0, true);
+  benchUnit<RobustScaler>("RobustScaler", [](Engine& e) { return new RobustScaler(10.0f, e); }, 0, true);
+  benchUnit<PeakDetector>("PeakDetector", [](Engine& e) { return new PeakDetector(0.5f, e); }, 0, true);
+
+  exit(0);
+}
+
+void loop() {}
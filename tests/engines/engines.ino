@@ -10,6 +10,18 @@ Engine engineLowerSamplingRate;
 
 Engine engineCustomTimeFunction;
 
+Engine engineDynamic;
+
+Engine engineDeadline;
+
+Engine engineBlocking;
+
+Engine engineVirtual;
+
+Metronome virtualMetro(1.0f, engineVirtual);
+Alarm virtualAlarm(1800.0f, engineVirtual);
+Ramp virtualRamp(3600.0f, engineVirtual);
+
 Metronome metro0(0.1);
 Metronome metro1(0.1, engine1);
 Metronome metro2(0.1, engine2);
@@ -96,6 +108,1202 @@ test(nUnits) {
   assertEqual((int)engine2.nUnits(), 2);
 }
 
+int dynamicFinishCount = 0;
+
+void dynamicFinishCallback() { dynamicFinishCount++; }
+
+test(dynamicUnits) {
+  assertEqual((int)engineDynamic.nUnits(), 0);
+
+  Ramp* ramp = new Ramp(1.0f, engineDynamic);
+  Alarm* alarm = new Alarm(0.0f, engineDynamic);
+  Wave* wave = new Wave(1.0f, engineDynamic);
+  alarm->onFinish(dynamicFinishCallback);
+  assertEqual((int)engineDynamic.nUnits(), 3);
+
+  // Remove unit in the middle: remaining units keep stepping.
+  delete ramp;
+  assertEqual((int)engineDynamic.nUnits(), 2);
+  engineDynamic.step();
+  alarm->start();
+  engineDynamic.step();
+  assertEqual((int)engineDynamic.nUnits(), 2);
+  assertEqual(dynamicFinishCount, 1);
+
+  // Removing a unit also removes its listeners.
+  delete alarm;
+  engineDynamic.step();
+  assertEqual((int)engineDynamic.nUnits(), 1);
+
+  // Slots are reused after compaction.
+  ramp = new Ramp(1.0f, engineDynamic);
+  assertEqual((int)engineDynamic.nUnits(), 2);
+  delete wave;
+  delete ramp;
+  assertEqual((int)engineDynamic.nUnits(), 0);
+  engineDynamic.step();
+}
+
+unsigned long deadlineMicros = 0;
+
+unsigned long deadlineMicroSeconds() { return deadlineMicros; }
+
+int overrunCount = 0;
+
+void overrunCallback() { overrunCount++; }
+
+test(deadline) {
+  engineDeadline.referenceClock(deadlineMicroSeconds);
+  engineDeadline.begin();
+  engineDeadline.sampleRate(1000);
+  engineDeadline.onOverrun(overrunCallback);
+  engineDeadline.step();
+
+  // On time.
+  deadlineMicros = 500;
+  assertFalse(engineDeadline.step());
+  deadlineMicros = 1000;
+  assertTrue(engineDeadline.step());
+  assertEqual(engineDeadline.nOverruns(), 0UL);
+  assertEqual(engineDeadline.maxLatenessMicroSeconds(), (uint32_t)0);
+
+  // Late after waiting: not an overrun.
+  deadlineMicros = 1500;
+  assertFalse(engineDeadline.step());
+  deadlineMicros = 2100;
+  assertTrue(engineDeadline.step());
+  assertEqual(engineDeadline.nOverruns(), 0UL);
+  assertEqual(engineDeadline.maxLatenessMicroSeconds(), (uint32_t)100);
+
+  // Next target is not shifted by previous lateness.
+  assertEqual(engineDeadline.microSecondsUntilNextStep(), (uint32_t)900);
+
+  // Missed deadline.
+  deadlineMicros = 4600;
+  assertTrue(engineDeadline.step());
+  assertEqual(engineDeadline.nOverruns(), 1UL);
+  assertEqual(overrunCount, 1);
+  assertEqual(engineDeadline.maxLatenessMicroSeconds(), (uint32_t)1600);
+  assertEqual(engineDeadline.jitterProfile().nSamples(), (uint32_t)3);
+  assertEqual(engineDeadline.jitterProfile().maxMicroSeconds(), (uint32_t)1500);
+
+  engineDeadline.resetTimingStats();
+  assertEqual(engineDeadline.nOverruns(), 0UL);
+  assertEqual(engineDeadline.jitterProfile().nSamples(), (uint32_t)0);
+}
+
+Engine engineCatchUp;
+
+unsigned long catchUpMicros = 0;
+
+unsigned long catchUpMicroSeconds() { return catchUpMicros; }
+
+test(catchUp) {
+  engineCatchUp.referenceClock(catchUpMicroSeconds);
+  engineCatchUp.begin();
+  engineCatchUp.sampleRate(1000);
+  engineCatchUp.catchUp(3);
+  assertTrue(engineCatchUp.hasCatchUp());
+  engineCatchUp.step();
+
+  catchUpMicros = 1000;
+  assertTrue(engineCatchUp.step());
+  assertEqual(engineCatchUp.nCatchUpSteps(), 0UL);
+
+  // Late by more than one period: catch up with nominal steps.
+  catchUpMicros = 3500;
+  for (int i=2; i<=3; i++) {
+    assertTrue(engineCatchUp.step());
+    assertEqual(engineCatchUp.microSeconds(), (uint64_t)(i*1000UL));
+    assertEqual(engineCatchUp.deltaTimeMicroSeconds(), (uint32_t)1000);
+  }
+  // Back on schedule.
+  assertFalse(engineCatchUp.step());
+  assertEqual(engineCatchUp.microSecondsUntilNextStep(), (uint32_t)500);
+  assertEqual(engineCatchUp.nCatchUpSteps(), 1UL);
+
+  // Too late: catch up with maximum number of steps, then resync.
+  catchUpMicros = 20000;
+  for (int i=4; i<=6; i++) {
+    assertTrue(engineCatchUp.step());
+    assertEqual(engineCatchUp.microSeconds(), (uint64_t)(i*1000UL));
+  }
+  assertTrue(engineCatchUp.step());
+  assertEqual(engineCatchUp.microSeconds(), (uint64_t)20000);
+  assertFalse(engineCatchUp.step());
+  assertEqual(engineCatchUp.microSecondsUntilNextStep(), (uint32_t)1000);
+  assertEqual(engineCatchUp.nCatchUpSteps(), 4UL);
+
+  // Disabled: single long step.
+  engineCatchUp.noCatchUp();
+  catchUpMicros = 25000;
+  assertTrue(engineCatchUp.step());
+  assertEqual(engineCatchUp.deltaTimeMicroSeconds(), (uint32_t)5000);
+  assertFalse(engineCatchUp.step());
+}
+
+Engine engineStable;
+
+unsigned long stableMicros = 0;
+
+unsigned long stableMicroSeconds() { return stableMicros; }
+
+test(stableSampleRate) {
+  engineStable.referenceClock(stableMicroSeconds);
+  engineStable.begin();
+  engineStable.step();
+
+  stableMicros += 1000;
+  engineStable.step();
+  assertNear(engineStable.stableSampleRate(), 1000.0f, 0.1f);
+  uint16_t version = engineStable.sampleRateVersion();
+
+  // Jitter does not change stable sample rate.
+  for (int i=0; i<100; i++) {
+    stableMicros += (i % 2 ? 980 : 1020);
+    engineStable.step();
+  }
+  assertEqual(engineStable.sampleRateVersion(), version);
+  assertNear(engineStable.stableSampleRate(), 1000.0f, 0.1f);
+
+  // Significant changes do.
+  for (int i=0; i<100; i++) {
+    stableMicros += 2000;
+    engineStable.step();
+  }
+  assertNotEqual(engineStable.sampleRateVersion(), version);
+  assertNear(engineStable.stableSampleRate(), 500.0f, 500.0f/32);
+
+  // Fixed sample rate is used directly.
+  engineStable.sampleRate(100);
+  assertNear(engineStable.stableSampleRate(), 100.0f, 0.001f);
+}
+
+unsigned long blockingMicros = 0;
+
+unsigned long blockingMicroSeconds() { return blockingMicros; }
+
+unsigned long blockingWaitTotal = 0;
+
+void blockingWait(uint32_t microSeconds) {
+  blockingMicros += microSeconds;
+  blockingWaitTotal += microSeconds;
+}
+
+test(stepBlocking) {
+  engineBlocking.referenceClock(blockingMicroSeconds);
+  engineBlocking.waitFunction(blockingWait);
+  engineBlocking.begin();
+  engineBlocking.sampleRate(100);
+
+  // Steps exactly on target, without drift.
+  for (int i=1; i<=10; i++) {
+    engineBlocking.stepBlocking();
+    assertEqual(engineBlocking.microSeconds(), (uint64_t)(i*10000UL));
+    blockingMicros += 1234; // time spent in step
+  }
+  assertEqual(blockingWaitTotal, 10*10000UL - 9*1234UL);
+
+  // No waiting in auto sample rate mode.
+  engineBlocking.autoSampleRate();
+  assertEqual(engineBlocking.microSecondsUntilNextStep(), (uint32_t)0);
+}
+
+test(virtualClock) {
+  engineVirtual.virtualClock(10);
+  engineVirtual.begin();
+  assertTrue(engineVirtual.hasVirtualClock());
+
+  virtualAlarm.start();
+  virtualRamp.go(0, 1, 3600.0f);
+  engineVirtual.step();
+
+  // Simulate one hour.
+  unsigned long nMetroBangs = 0;
+  unsigned long alarmFinishStep = 0;
+  unsigned long nSkippedSteps = 0;
+  for (unsigned long i=1; i<=36000UL; i++) {
+    if (!engineVirtual.step()) nSkippedSteps++;
+    if (virtualMetro) nMetroBangs++;
+    if (virtualAlarm.finished()) alarmFinishStep = i;
+    if (i == 9000UL)
+      assertNear(virtualRamp.get(), 0.25f, 0.001f);
+  }
+  assertEqual(nSkippedSteps, 0UL);
+  assertEqual(engineVirtual.microSeconds(), (uint64_t)3600000000ULL);
+  assertNear(engineVirtual.sampleRate(), 10.0f, 0.001f);
+  assertNear(engineVirtual.samplePeriod(), 0.1f, 0.0001f);
+  assertEqual(engineVirtual.deltaTimeMicroSeconds(), (uint32_t)100000UL);
+  assertNear(engineVirtual.deltaTimeSecondsTimesFixed32Max(), 0.1f * 4294967295.0f, 10000.0f);
+  assertNear(nMetroBangs, 3600UL, 1UL);
+  assertEqual(alarmFinishStep, 18000UL);
+  assertNear(virtualRamp.get(), 1.0f, 0.001f);
+
+  engineVirtual.noVirtualClock();
+  assertFalse(engineVirtual.hasVirtualClock());
+}
+
+Engine enginePhase;
+
+Metronome phaseMetro(0.0075f, enginePhase);
+Wave phaseWave(0.25f, enginePhase);
+
+test(integerPhase) {
+  // Phase increment per microsecond: mantissa / 2^shift.
+  uint32_t mantissa;
+  uint8_t shift;
+  frequencyToPhase32PerMicros(0.25f, mantissa, shift);
+  q0_32u_t phase32 = 0;
+  assertFalse(phase32UpdateMicros(phase32, 1000000UL, mantissa, shift));
+  assertNear(phase32, (q0_32u_t)1073741824UL, (q0_32u_t)256);
+  assertTrue(phase32UpdateMicros(phase32, 3100000UL, mantissa, shift));
+  assertNear(phase32, (q0_32u_t)107374182UL, (q0_32u_t)512);
+
+  // Oscillators step phase from integer microseconds: 7.5 steps per period.
+  enginePhase.virtualClock(1000);
+  enginePhase.begin();
+  enginePhase.step();
+  unsigned long nBangs = 0;
+  for (int i=0; i<7503; i++) {
+    enginePhase.step();
+    if (phaseMetro) nBangs++;
+  }
+  assertEqual(nBangs, 1000UL);
+  assertNear(phaseWave.phase(), 0.012f, 0.0001f); // 7.503 s at 0.25 Hz
+}
+
+Engine engineScaled;
+
+Ramp scaledRamp(engineScaled);
+
+unsigned long scaledMicros = 0;
+
+unsigned long scaledMicroSeconds() { return scaledMicros; }
+
+test(timeScale) {
+  engineScaled.referenceClock(scaledMicroSeconds);
+  engineScaled.begin();
+  engineScaled.sampleRate(1000);
+  engineScaled.timeScale(10);
+  assertNear(engineScaled.timeScale(), 10.0f, 0.001f);
+  engineScaled.step();
+  scaledRamp.go(0, 1, 1.0f);
+
+  // Fast-forward: steps of 1 ms are taken every 100 us of real time.
+  assertEqual(engineScaled.microSecondsUntilNextStep(), (uint32_t)100);
+  scaledMicros = 50;
+  assertFalse(engineScaled.step());
+  scaledMicros = 100;
+  assertTrue(engineScaled.step());
+  assertEqual(engineScaled.deltaTimeMicroSeconds(), (uint32_t)1000);
+  assertEqual(engineScaled.microSeconds(), (uint64_t)1000);
+  for (int i=2; i<=500; i++) {
+    scaledMicros = i*100;
+    assertTrue(engineScaled.step());
+  }
+  assertNear(scaledRamp.get(), 0.5f, 0.01f);
+
+  // Slow motion: time continues from current time.
+  engineScaled.timeScale(0.1f);
+  assertEqual(engineScaled.microSeconds(false), (uint64_t)500000);
+  scaledMicros += 5000;
+  assertFalse(engineScaled.step());
+  scaledMicros += 5000;
+  assertTrue(engineScaled.step());
+  assertEqual(engineScaled.microSeconds(), (uint64_t)501000);
+  assertEqual(engineScaled.deltaTimeMicroSeconds(), (uint32_t)1000);
+}
+
+Engine engineScaledLong;
+
+uint64_t scaledLongMicros = 0;
+
+uint64_t scaledLongMicroSeconds() { return scaledLongMicros; }
+
+test(timeScaleLongRun) {
+  engineScaledLong.referenceClock(scaledLongMicroSeconds, MICROS_PER_SECOND);
+  engineScaledLong.begin();
+  engineScaledLong.timeScale(1000);
+
+  // About 3 years of real time: product of elapsed time and scale exceeds 64 bits.
+  scaledLongMicros = 100000000000000ULL;
+  assertEqual(engineScaledLong.microSeconds(false), (uint64_t)100000000000000000ULL);
+  scaledLongMicros += 1;
+  assertEqual(engineScaledLong.microSeconds(false), (uint64_t)100000000000001000ULL);
+}
+
+Engine engineNano;
+
+Engine engineNanoVirtual;
+
+uint64_t nanoTicks = 0;
+
+uint64_t nanoClock() { return nanoTicks; }
+
+test(nanoClock) {
+  // Start far beyond 32-bit microseconds.
+  nanoTicks = 5000000000000000ULL; // 5e6 seconds
+  engineNano.referenceClock(nanoClock, NANOS_PER_SECOND);
+  engineNano.begin();
+  assertEqual(engineNano.microSeconds(false), (uint64_t)5000000000000ULL);
+  nanoTicks += 1999;
+  assertEqual(engineNano.microSeconds(false), (uint64_t)5000000000001ULL);
+
+  // Sample rate that is not a whole number of microseconds: average rate is exact.
+  engineNano.sampleRate(300000);
+  engineNano.step();
+  uint64_t startMicros = engineNano.microSeconds();
+  unsigned long nSteps = 0;
+  for (unsigned long i=0; i<30000UL; i++) { // 3 ms in 100 ns increments
+    nanoTicks += 100;
+    if (engineNano.step())
+      nSteps++;
+  }
+  assertNear(nSteps, 900UL, 1UL);
+  assertNear(engineNano.microSeconds() - startMicros, (uint64_t)3000, (uint64_t)4);
+
+  // Same in virtual clock mode.
+  engineNanoVirtual.virtualClock(300000);
+  engineNanoVirtual.begin();
+  engineNanoVirtual.step();
+  startMicros = engineNanoVirtual.microSeconds();
+  for (int i=0; i<30000; i++)
+    engineNanoVirtual.step();
+  assertNear(engineNanoVirtual.microSeconds() - startMicros, (uint64_t)100000, (uint64_t)1);
+}
+
+Engine engineGraph;
+
+// Unit that holds the last value it received.
+class Relay : public AnalogSource {
+public:
+  Relay(Engine& engine) : AnalogSource(engine) {}
+  virtual float put(float value) { return (_value = value); }
+};
+
+// Created in reverse data flow order.
+Relay relayC(engineGraph);
+Relay relayB(engineGraph);
+Relay relayA(engineGraph);
+
+test(connections) {
+  engineGraph.begin();
+  engineGraph.step();
+
+  // Declared in any order.
+  assertTrue(engineGraph.connect(relayB, relayC));
+  assertTrue(engineGraph.connect(relayA, relayB));
+  assertTrue(engineGraph.connect(relayA, relayB));
+  assertEqual((int)engineGraph.nConnections(), 2);
+
+  // Cycles are refused.
+  assertFalse(engineGraph.connect(relayC, relayA));
+  assertFalse(engineGraph.connect(relayA, relayA));
+  assertFalse(engineGraph.connect(relayA, virtualMetro));
+  assertEqual((int)engineGraph.nConnections(), 2);
+
+  // Values go through the whole chain in one step.
+  relayA.put(0.25f);
+  engineGraph.step();
+  assertEqual(relayB.get(), 0.25f);
+  assertEqual(relayC.get(), 0.25f);
+
+  // Removed connections stop propagating.
+  assertTrue(engineGraph.disconnect(relayB, relayC));
+  assertFalse(engineGraph.disconnect(relayB, relayC));
+  relayA.put(0.5f);
+  engineGraph.step();
+  assertEqual(relayB.get(), 0.5f);
+  assertEqual(relayC.get(), 0.25f);
+  assertEqual((int)engineGraph.nConnections(), 1);
+
+  // Destroying a unit removes its connections.
+  Relay* relayD = new Relay(engineGraph);
+  assertTrue(engineGraph.connect(relayB, *relayD));
+  assertTrue(engineGraph.connect(*relayD, relayC));
+  engineGraph.step();
+  assertEqual(relayC.get(), 0.5f);
+  delete relayD;
+  assertEqual((int)engineGraph.nConnections(), 1);
+  relayA.put(0.75f);
+  engineGraph.step();
+  assertEqual(relayB.get(), 0.75f);
+  assertEqual(relayC.get(), 0.5f);
+}
+
+Engine engineIdle;
+
+Ramp idleRamp(1.0f, engineIdle);
+Alarm idleAlarm(0.5f, engineIdle);
+Chronometer idleChrono(engineIdle);
+Wave idleWave(1.0f, engineIdle);
+
+int idleFinishCount = 0;
+
+void idleFinishCallback() { idleFinishCount++; }
+
+test(idleUnits) {
+  engineIdle.virtualClock(100);
+  engineIdle.begin();
+  idleAlarm.onFinish(idleFinishCallback);
+  engineIdle.step();
+  engineIdle.step();
+
+  // Units that are not running become dormant.
+  assertTrue(idleRamp.isDormant());
+  assertTrue(idleAlarm.isDormant());
+  assertTrue(idleChrono.isDormant());
+  assertFalse(idleWave.isDormant());
+
+  // Starting wakes units up.
+  idleRamp.go(0, 1, 1.0f);
+  idleAlarm.start();
+  idleChrono.start();
+  idleWave.pause();
+  assertFalse(idleRamp.isDormant());
+  assertFalse(idleAlarm.isDormant());
+  assertFalse(idleChrono.isDormant());
+  for (int i=0; i<50; i++)
+    engineIdle.step();
+  assertNear(idleRamp.get(), 0.5f, 0.01f);
+  assertNear(idleChrono.elapsed(), 0.5f, 0.01f);
+  assertTrue(idleWave.isDormant());
+
+  // Finished timers become dormant once their events have been triggered, but time keeps going.
+  for (int i=0; i<60; i++)
+    engineIdle.step();
+  assertEqual(idleFinishCount, 1);
+  assertTrue(idleAlarm.isOn());
+  assertTrue(idleAlarm.isDormant());
+  assertTrue(idleRamp.isDormant());
+  assertEqual(idleRamp.get(), 1.0f);
+  assertNear(idleAlarm.elapsed(), 1.1f, 0.01f);
+  assertNear(idleRamp.progress(), 1.0f, 0.01f);
+
+  // Changing parameters wakes units up.
+  idleAlarm.duration(2.0f);
+  engineIdle.step();
+  assertFalse(idleAlarm.isOn());
+  assertFalse(idleAlarm.isDormant());
+
+  // Pausing preserves elapsed time.
+  idleChrono.pause();
+  engineIdle.step();
+  assertTrue(idleChrono.isDormant());
+  float elapsed = idleChrono.elapsed();
+  for (int i=0; i<10; i++)
+    engineIdle.step();
+  assertEqual(idleChrono.elapsed(), elapsed);
+  idleChrono.resume();
+  engineIdle.step();
+  assertNear(idleChrono.elapsed(), elapsed + 0.01f, 0.001f);
+}
+
+Engine engineEvents;
+
+Wave eventWave(0.1f, engineEvents);
+Metronome eventMetro(0.25f, engineEvents);
+Ramp eventRamp(0.5f, engineEvents);
+Alarm eventAlarm(0.3f, engineEvents);
+PeakDetector eventPeak(0.5f, PEAK_RISING, engineEvents);
+
+int eventWaveBangs = 0;
+int eventMetroBangs = 0;
+int eventRampFinishes = 0;
+int eventAlarmFinishes = 0;
+int eventAlarmRises = 0;
+int eventPeakBangs = 0;
+
+void eventWaveCallback() { eventWaveBangs++; }
+void eventMetroCallback() { eventMetroBangs++; }
+void eventRampCallback() { eventRampFinishes++; }
+void eventAlarmFinishCallback() { eventAlarmFinishes++; }
+void eventAlarmRiseCallback() { eventAlarmRises++; }
+void eventPeakCallback() { eventPeakBangs++; }
+
+test(events) {
+  engineEvents.virtualClock(100);
+  engineEvents.begin();
+  eventWave.onBang(eventWaveCallback);
+  eventMetro.onBang(eventMetroCallback);
+  eventRamp.onFinish(eventRampCallback);
+  eventAlarm.onFinish(eventAlarmFinishCallback);
+  eventAlarm.onRise(eventAlarmRiseCallback);
+  eventPeak.onBang(eventPeakCallback); // polled event
+  eventRamp.go(0, 1, 0.5f);
+  eventAlarm.start();
+
+  // Raised events reach their listeners once per occurrence.
+  for (int i=0; i<100; i++) {
+    eventPeak.put(i % 20 < 10 ? 0 : 1);
+    engineEvents.step();
+  }
+  assertNear(eventWaveBangs, 10, 1);
+  assertNear(eventMetroBangs, 4, 1);
+  assertEqual(eventRampFinishes, 1);
+  assertEqual(eventAlarmFinishes, 1);
+  assertEqual(eventAlarmRises, 1);
+  assertEqual(eventPeakBangs, 5);
+
+  // Cleared listeners are no longer called.
+  eventWave.clearEvents();
+  for (int i=0; i<100; i++)
+    engineEvents.step();
+  assertNear(eventWaveBangs, 10, 1);
+  assertNear(eventMetroBangs, 8, 1);
+}
+
+Engine engineContextEvents;
+
+Metronome contextMetros[] = {
+  Metronome(0.1f, engineContextEvents),
+  Metronome(0.2f, engineContextEvents),
+  Metronome(0.5f, engineContextEvents)
+};
+
+int contextBangs[3] = { 0, 0, 0 };
+
+void contextCallback(void* context) { (*static_cast<int*>(context))++; }
+
+struct BangCounter {
+  int count;
+  void bang() { count++; }
+};
+
+BangCounter contextCounter = { 0 };
+
+test(contextEvents) {
+  engineContextEvents.virtualClock(100);
+  engineContextEvents.begin();
+
+  // One handler serves all units.
+  for (int i=0; i<3; i++)
+    contextMetros[i].onBang(contextCallback, &contextBangs[i]);
+
+  // Member function.
+  contextMetros[0].onBang(eventMethod<BangCounter, &BangCounter::bang>, &contextCounter);
+
+  for (int i=0; i<100; i++)
+    engineContextEvents.step();
+  assertNear(contextBangs[0], 10, 1);
+  assertNear(contextBangs[1], 5, 1);
+  assertNear(contextBangs[2], 2, 1);
+  assertEqual(contextCounter.count, contextBangs[0]);
+
+  // Removed listener is no longer called, other listeners are kept.
+  contextMetros[0].removeEvent(eventMethod<BangCounter, &BangCounter::bang>, &contextCounter, EVENT_BANG);
+  for (int i=0; i<100; i++)
+    engineContextEvents.step();
+  assertNear(contextBangs[0], 20, 1);
+  assertNear(contextCounter.count, 10, 1);
+}
+
+Engine engineQueue;
+
+// Unit that raises bangs and triggers polled change events on demand.
+class QueueSource : public Unit {
+public:
+  QueueSource(Engine& engine) : Unit(engine), nBangs(0), changed(false) {}
+  void onBang(EventCallback callback) { onEvent(callback, EVENT_BANG); }
+  void onBang(EventContextCallback callback, void* context) { onEvent(callback, context, EVENT_BANG); }
+  void onChange(EventContextCallback callback, void* context) { onEvent(callback, context, EVENT_CHANGE); }
+  int nBangs;
+  bool changed;
+protected:
+  virtual void step() { for (; nBangs > 0; nBangs--) _raiseEvent(EVENT_BANG); }
+  virtual bool raisesEvent(EventType eventType) const { return eventType == EVENT_BANG; }
+  virtual bool eventTriggered(EventType eventType) { return eventType == EVENT_CHANGE && changed; }
+};
+
+QueueSource queueSourceA(engineQueue);
+QueueSource queueSourceB(engineQueue);
+
+struct QueueRecord {
+  int count;
+  unsigned long step;
+  uint32_t microSeconds;
+};
+
+QueueRecord queueBangs = { 0, 0, 0 };
+QueueRecord queueBangs2 = { 0, 0, 0 };
+QueueRecord queueChanges = { 0, 0, 0 };
+
+void queueCallback(void* context) {
+  QueueRecord* record = static_cast<QueueRecord*>(context);
+  record->count++;
+  record->step = engineQueue.eventStep();
+  record->microSeconds = engineQueue.eventMicroSeconds();
+}
+
+test(eventQueue) {
+  engineQueue.virtualClock(100);
+  engineQueue.begin();
+  engineQueue.step();
+  assertTrue(engineQueue.eventQueue(3));
+  assertTrue(engineQueue.hasEventQueue());
+  queueSourceA.onBang(queueCallback, &queueBangs);
+  queueSourceA.onBang(queueCallback, &queueBangs2);
+  queueSourceB.onChange(queueCallback, &queueChanges);
+
+  // Events are queued instead of dispatched; same event is recorded once per step.
+  queueSourceA.nBangs = 2;
+  engineQueue.step();
+  unsigned long bangStep = engineQueue.nSteps();
+  uint32_t bangMicroSeconds = engineQueue.microSeconds();
+  queueSourceB.changed = true;
+  engineQueue.step();
+  queueSourceB.changed = false;
+  unsigned long changeStep = engineQueue.nSteps();
+  engineQueue.step();
+  assertEqual(engineQueue.nQueuedEvents(), (size_t)2);
+  assertEqual(queueBangs.count, 0);
+  assertEqual(queueChanges.count, 0);
+
+  // Dispatch in batches, with timestamps of original steps.
+  assertEqual(engineQueue.dispatchEvents(1), (size_t)1);
+  assertEqual(queueBangs.count, 1);
+  assertEqual(queueBangs2.count, 1);
+  assertEqual(queueChanges.count, 0);
+  assertEqual(queueBangs.step, bangStep);
+  assertEqual(queueBangs.microSeconds, bangMicroSeconds);
+  assertEqual(engineQueue.dispatchEvents(), (size_t)1);
+  assertEqual(queueChanges.count, 1);
+  assertEqual(queueChanges.step, changeStep);
+  assertEqual(engineQueue.nQueuedEvents(), (size_t)0);
+  assertEqual(engineQueue.dispatchEvents(), (size_t)0);
+
+  // Full queue dispatches oldest event to make room.
+  unsigned long firstStep = engineQueue.nSteps() + 1;
+  for (int i=0; i<4; i++) {
+    queueSourceA.nBangs = 1;
+    engineQueue.step();
+  }
+  assertEqual(engineQueue.nQueuedEvents(), (size_t)3);
+  assertEqual(engineQueue.nEventQueueOverflows(), 1UL);
+  assertEqual(queueBangs.count, 2);
+  assertEqual(queueBangs.step, firstStep);
+
+  // Disabling queue dispatches remaining events.
+  engineQueue.noEventQueue();
+  assertFalse(engineQueue.hasEventQueue());
+  assertEqual(queueBangs.count, 5);
+  assertEqual(queueBangs.step, firstStep + 3);
+
+  // Without queue, events are dispatched during step (also once per step).
+  queueSourceA.nBangs = 1;
+  engineQueue.step();
+  assertEqual(queueBangs.count, 6);
+  queueSourceA.nBangs = 2;
+  engineQueue.step();
+  assertEqual(queueBangs.count, 7);
+}
+
+Engine engineListeners;
+
+QueueSource listenersSource(engineListeners);
+
+int nSelfRemovingCalls = 0;
+int nOtherListenerCalls = 0;
+
+void selfRemovingCallback() {
+  nSelfRemovingCalls++;
+  listenersSource.removeEvent(selfRemovingCallback, EVENT_BANG);
+}
+
+void otherListenerCallback() { nOtherListenerCalls++; }
+
+// Digital source that computes its change state itself (without _updateChangeState()).
+class PolledDigitalSource : public DigitalSource {
+public:
+  PolledDigitalSource(Engine& engine) : DigitalSource(engine), state(0) {}
+  int8_t state;
+  virtual int8_t changeState() { return state; }
+};
+
+PolledDigitalSource polledDigital(engineListeners);
+
+int nPolledChanges = 0;
+
+void polledChangeCallback() { nPolledChanges++; }
+
+test(eventListenerChanges) {
+  engineListeners.virtualClock(100);
+  engineListeners.begin();
+  engineListeners.step();
+
+  // Callback removes itself: following listener is still called exactly once.
+  listenersSource.onBang(selfRemovingCallback);
+  listenersSource.onBang(otherListenerCallback);
+  listenersSource.nBangs = 1;
+  engineListeners.step();
+  assertEqual(nSelfRemovingCalls, 1);
+  assertEqual(nOtherListenerCalls, 1);
+  listenersSource.nBangs = 1;
+  engineListeners.step();
+  assertEqual(nSelfRemovingCalls, 1);
+  assertEqual(nOtherListenerCalls, 2);
+
+  // Change events of digital sources that do not raise them are polled.
+  polledDigital.onChange(polledChangeCallback);
+  polledDigital.state = 1;
+  engineListeners.step();
+  polledDigital.state = 0;
+  engineListeners.step();
+  assertEqual(nPolledChanges, 1);
+}
+
+Engine engineTrace;
+
+QueueSource traceSource(engineTrace);
+
+int traceBangs = 0;
+
+void traceCallback() { traceBangs++; }
+
+// Reads little-endian 32-bit value.
+uint32_t traceValue(const uint8_t* bytes) {
+  return bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+test(eventTrace) {
+  engineTrace.virtualClock(100);
+  engineTrace.begin();
+  engineTrace.step();
+  assertTrue(engineTrace.eventTrace(8));
+  assertTrue(engineTrace.hasEventTrace());
+  traceSource.onBang(traceCallback);
+
+  // Each step and each callback call is recorded.
+  traceSource.nBangs = 1;
+  engineTrace.step();
+  unsigned long bangStep = engineTrace.nSteps();
+  engineTrace.step();
+  assertEqual(traceBangs, 1);
+  assertEqual(engineTrace.nEventTraceRecords(), (size_t)3);
+
+  uint8_t buffer[EVENT_TRACE_HEADER_SIZE + 8*EVENT_TRACE_RECORD_SIZE];
+  BufferStateWriter writer(buffer, sizeof(buffer));
+  assertTrue(engineTrace.dumpEventTrace(writer));
+  assertEqual(writer.size(), (size_t)(EVENT_TRACE_HEADER_SIZE + 3*EVENT_TRACE_RECORD_SIZE));
+  assertTrue(memcmp(buffer, "PQTR", 4) == 0);
+  assertEqual(buffer[4], (uint8_t)EVENT_TRACE_FORMAT_VERSION);
+  assertEqual(buffer[5], (uint8_t)EVENT_TRACE_RECORD_SIZE);
+  assertEqual(traceValue(buffer + 6), (uint32_t)3);
+  assertEqual(traceValue(buffer + 10), (uint32_t)0);
+
+  // Step record followed by dispatch record of the same step.
+  const uint8_t* record = buffer + EVENT_TRACE_HEADER_SIZE;
+  assertEqual(traceValue(record + 4), (uint32_t)bangStep);
+  assertEqual(record[11], (uint8_t)EventTrace::RECORD_STEP);
+  record += EVENT_TRACE_RECORD_SIZE;
+  assertEqual(traceValue(record + 4), (uint32_t)bangStep);
+  assertEqual(record[10], (uint8_t)EVENT_BANG);
+  assertEqual(record[11], (uint8_t)EventTrace::RECORD_DISPATCH);
+  assertMoreOrEqual(traceValue(record), traceValue(record - EVENT_TRACE_RECORD_SIZE));
+
+  // Oldest records are overwritten when full.
+  for (int i=0; i<10; i++)
+    engineTrace.step();
+  assertEqual(engineTrace.nEventTraceRecords(), (size_t)8);
+  BufferStateWriter fullWriter(buffer, sizeof(buffer));
+  assertTrue(engineTrace.dumpEventTrace(fullWriter));
+  assertEqual(traceValue(buffer + 10), (uint32_t)5);
+
+  engineTrace.clearEventTrace();
+  assertEqual(engineTrace.nEventTraceRecords(), (size_t)0);
+
+  engineTrace.noEventTrace();
+  assertFalse(engineTrace.hasEventTrace());
+  assertFalse(engineTrace.dumpEventTrace(writer));
+}
+
+Engine engineDecimation;
+
+// Unit that counts its steps.
+class StepCounter : public Unit {
+public:
+  StepCounter(Engine& engine) : Unit(engine), nSteps(0) {}
+  unsigned long nSteps;
+protected:
+  virtual void step() { nSteps++; }
+};
+
+StepCounter fullRateCounter(engineDecimation);
+StepCounter decimatedCounter(engineDecimation);
+Wave fullRateWave(SINE, 1.7f, engineDecimation);
+Wave decimatedWave(SINE, 1.7f, engineDecimation);
+
+test(decimation) {
+  engineDecimation.virtualClock(100);
+  engineDecimation.begin();
+  decimatedCounter.decimation(10);
+  decimatedWave.decimation(10);
+  assertEqual(decimatedCounter.decimation(), (uint16_t)10);
+  assertEqual(fullRateCounter.decimation(), (uint16_t)1);
+  engineDecimation.step();
+
+  // Decimated units step on first step, then every 10 steps.
+  for (int i=0; i<991; i++)
+    engineDecimation.step();
+  assertEqual(fullRateCounter.nSteps, 991UL);
+  assertEqual(decimatedCounter.nSteps, 100UL);
+
+  // Time between steps accounts for decimation.
+  assertEqual(decimatedCounter.deltaTimeMicroSeconds(), (uint32_t)100000);
+  assertNear(decimatedCounter.sampleRate(), 10.0f, 0.001f);
+  assertNear(decimatedCounter.samplePeriod(), 0.1f, 0.0001f);
+  assertNear(fullRateCounter.sampleRate(), 100.0f, 0.001f);
+
+  // Decimated wave is updated less often, but stays in phase with full rate wave.
+  assertNear(decimatedWave.get(), fullRateWave.get(), 0.001f);
+  for (int i=0; i<5; i++)
+    engineDecimation.step();
+  assertNotEqual(decimatedWave.get(), fullRateWave.get());
+  for (int i=0; i<5; i++)
+    engineDecimation.step();
+  assertNear(decimatedWave.get(), fullRateWave.get(), 0.001f);
+}
+
+StaticEngine<StepCounter, Metronome, StepCounter> engineStatic;
+
+test(staticEngine) {
+  assertEqual(engineStatic.nStaticUnits(), (size_t)3);
+  assertEqual((int)engineStatic.nUnits(), 3);
+
+  engineStatic.virtualClock(100);
+  engineStatic.begin();
+  engineStatic.unit<1>().period(0.1f);
+  engineStatic.unit<2>().decimation(4);
+  engineStatic.step();
+
+  int nBangs = 0;
+  for (int i=0; i<100; i++) {
+    assertTrue(engineStatic.step());
+    if (engineStatic.unit<1>())
+      nBangs++;
+  }
+  assertEqual(engineStatic.unit<0>().nSteps, 100UL);
+  assertEqual(engineStatic.unit<2>().nSteps, 25UL);
+  assertNear(nBangs, 10, 1);
+  assertNear(engineStatic.seconds(), 1.0f, 0.0001f);
+  assertNear(engineStatic.sampleRate(), 100.0f, 0.01f);
+
+  // Units are also stepped when stepping through an Engine reference (eg. as a child engine).
+  Engine& baseEngine = engineStatic;
+  for (int i=0; i<4; i++)
+    assertTrue(baseEngine.step());
+  assertEqual(engineStatic.unit<0>().nSteps, 104UL);
+  assertEqual(engineStatic.unit<2>().nSteps, 26UL);
+}
+
+Engine engineParent;
+Engine engineChild;
+Engine engineGrandChild;
+
+StepCounter childCounter(engineChild);
+StepCounter grandChildCounter(engineGrandChild);
+
+unsigned long childClockReads = 0;
+
+unsigned long childMicroSeconds() { return ++childClockReads; }
+
+test(childEngines) {
+  engineParent.virtualClock(1000);
+  engineChild.referenceClock(childMicroSeconds);
+  assertTrue(engineParent.addChild(engineChild, 10));
+  assertTrue(engineChild.addChild(engineGrandChild, 5));
+  assertFalse(engineGrandChild.addChild(engineParent));
+  assertFalse(engineChild.addChild(engineChild));
+  assertEqual((int)engineParent.nChildren(), 1);
+  assertTrue(engineChild.parent() == &engineParent);
+
+  engineParent.begin();
+  engineParent.step();
+  childClockReads = 0;
+
+  for (int i=1; i<=1000; i++) {
+    engineParent.step();
+    if (i % 10 == 1) // child steps with parent, exactly aligned
+      assertEqual(engineChild.microSeconds(), engineParent.microSeconds());
+  }
+  assertEqual(childCounter.nSteps, 100UL);
+  assertEqual(grandChildCounter.nSteps, 20UL);
+  assertEqual(engineChild.deltaTimeMicroSeconds(), (uint32_t)10000);
+  assertEqual(engineGrandChild.deltaTimeMicroSeconds(), (uint32_t)50000);
+  assertEqual(childClockReads, 0UL);
+
+  // Removed child uses its own clock again.
+  assertTrue(engineParent.removeChild(engineChild));
+  assertFalse(engineParent.removeChild(engineChild));
+  assertTrue(engineChild.parent() == 0);
+  engineChild.step();
+  engineChild.step();
+  assertMore(childClockReads, 0UL);
+}
+
+Engine engineLateChild;
+
+StepCounter lateChildCounter(engineLateChild);
+
+unsigned long lateChildMicros = 0;
+
+unsigned long lateChildMicroSeconds() { return lateChildMicros; }
+
+test(childEngineLifecycle) {
+  engineLateChild.referenceClock(lateChildMicroSeconds);
+  Engine* parent = new Engine();
+  parent->virtualClock(1000);
+  parent->begin();
+  parent->step();
+  for (int i=0; i<10; i++)
+    parent->step();
+
+  // Child added to a running parent steps on the parent's next step.
+  assertTrue(parent->addChild(engineLateChild));
+  assertEqual(lateChildCounter.nSteps, 0UL);
+  parent->step();
+  assertEqual(lateChildCounter.nSteps, 1UL);
+  parent->step();
+  assertEqual(lateChildCounter.nSteps, 2UL);
+  assertEqual(engineLateChild.deltaTimeMicroSeconds(), (uint32_t)1000);
+
+  // Destroyed parent: child restarts from its own clock.
+  delete parent;
+  assertTrue(engineLateChild.parent() == 0);
+  lateChildMicros = 50;
+  engineLateChild.step();
+  lateChildMicros += 500;
+  assertTrue(engineLateChild.step());
+  assertEqual(engineLateChild.deltaTimeMicroSeconds(), (uint32_t)500);
+  assertEqual(lateChildCounter.nSteps, 3UL);
+}
+
+Engine enginePriority;
+
+unsigned long priorityMicros = 0;
+
+unsigned long priorityMicroSeconds() { return priorityMicros; }
+
+char priorityTrace[16];
+int priorityTraceSize = 0;
+
+// Unit that takes some time to step and records its steps.
+class TracedUnit : public Unit {
+public:
+  TracedUnit(char id, uint32_t cost, Engine& engine) : Unit(engine), id(id), cost(cost), elapsedMicros(0) {}
+  char id;
+  uint32_t cost;
+  uint32_t elapsedMicros;
+protected:
+  virtual void step() {
+    elapsedMicros += deltaTimeMicroSeconds();
+    priorityMicros += cost;
+    if (priorityTraceSize < 15)
+      priorityTrace[priorityTraceSize++] = id;
+    priorityTrace[priorityTraceSize] = 0;
+  }
+};
+
+TracedUnit tracedOutput('o', 0, enginePriority);
+TracedUnit tracedFilter('f', 100, enginePriority);
+TracedUnit tracedInput('i', 600, enginePriority);
+TracedUnit tracedFilter2('g', 100, enginePriority);
+
+test(priority) {
+  enginePriority.referenceClock(priorityMicroSeconds);
+  tracedOutput.priority(PRIORITY_OUTPUT);
+  tracedInput.priority(PRIORITY_INPUT);
+  assertEqual(tracedFilter.priority(), (uint8_t)PRIORITY_DEFAULT);
+  enginePriority.begin();
+  enginePriority.step();
+
+  // Stepped by priority, then in order of creation.
+  priorityMicros += 1000;
+  enginePriority.step();
+  assertEqual(priorityTrace, "ifgo");
+
+  // Over budget: lower priority classes deferred to next step (but never twice in a row).
+  enginePriority.stepBudget(500);
+  priorityTraceSize = 0;
+  for (int i=0; i<3; i++) {
+    priorityMicros += 1000;
+    enginePriority.step();
+  }
+  assertEqual(priorityTrace, "iifgoi");
+  assertEqual(enginePriority.nDeferredSteps(), 2UL);
+
+  // Within budget.
+  enginePriority.stepBudget(1000);
+  priorityTraceSize = 0;
+  priorityMicros += 1000;
+  enginePriority.step();
+  assertEqual(priorityTrace, "ifgo");
+  assertEqual(enginePriority.nDeferredSteps(), 2UL);
+
+  // Deferred units catch up with the time they skipped.
+  assertEqual(tracedOutput.elapsedMicros, tracedInput.elapsedMicros);
+  assertEqual(tracedFilter2.elapsedMicros, tracedInput.elapsedMicros);
+}
+
+#if PQ_PROFILE
+Engine engineProfile;
+
+// Unit that takes a given time to step.
+class ProfiledUnit : public Unit {
+public:
+  ProfiledUnit(uint32_t cost, Engine& engine) : Unit(engine), cost(cost) {}
+  uint32_t cost;
+protected:
+  virtual void step() {
+    uint32_t startTime = micros();
+    while (micros() - startTime < cost);
+  }
+};
+
+// More units than the inline capacity of the engine, slowest last (ranked first in report).
+ProfiledUnit profiledUnits[] = {
+  ProfiledUnit(10, engineProfile), ProfiledUnit(20, engineProfile), ProfiledUnit(30, engineProfile),
+  ProfiledUnit(40, engineProfile), ProfiledUnit(50, engineProfile), ProfiledUnit(60, engineProfile),
+  ProfiledUnit(70, engineProfile), ProfiledUnit(80, engineProfile), ProfiledUnit(90, engineProfile),
+  ProfiledUnit(100, engineProfile)
+};
+
+test(profile) {
+  engineProfile.virtualClock(100);
+  engineProfile.begin();
+  engineProfile.step();
+  for (int i=0; i<3; i++)
+    engineProfile.step();
+
+  assertEqual(engineProfile.nUnits(), (size_t)10);
+  for (int i=0; i<10; i++)
+    assertEqual(profiledUnits[i].stepProfile().nSamples(), (uint32_t)3);
+  assertMore(profiledUnits[9].stepProfile().totalMicroSeconds(), profiledUnits[0].stepProfile().totalMicroSeconds());
+  engineProfile.printProfile();
+
+  engineProfile.resetProfile();
+  assertEqual(profiledUnits[9].stepProfile().nSamples(), (uint32_t)0);
+}
+#endif
+
+Engine engineSaved;
+Normalizer savedNormalizer(10.0f, engineSaved);
+MinMaxScaler savedScaler(engineSaved);
+Wave savedWave(SINE, 0.3f, engineSaved);
+Ramp savedRamp(engineSaved);
+
+Engine engineRestored;
+Normalizer restoredNormalizer(10.0f, engineRestored);
+MinMaxScaler restoredScaler(engineRestored);
+Wave restoredWave(SINE, 0.3f, engineRestored);
+Ramp restoredRamp(engineRestored);
+
+test(saveState) {
+  engineSaved.virtualClock(100);
+  engineSaved.begin();
+  savedRamp.go(0, 10, 20.0f);
+  for (int i=0; i<1000; i++) {
+    engineSaved.step();
+    float value = 5.0f + 2.0f * sin(i * 0.1f);
+    value >> savedNormalizer;
+    value >> savedScaler;
+  }
+
+  // Save to memory.
+  uint8_t buffer[128];
+  BufferStateWriter writer(buffer, sizeof(buffer));
+  assertTrue(engineSaved.saveState(writer));
+
+  // Restore in another engine, as after a restart.
+  engineRestored.virtualClock(100);
+  engineRestored.begin();
+  engineRestored.step();
+  BufferStateReader reader(buffer, writer.size());
+  assertTrue(engineRestored.loadState(reader));
+  engineRestored.step();
+  engineSaved.step();
+
+  assertEqual(restoredNormalizer.mean(), savedNormalizer.mean());
+  assertEqual(restoredNormalizer.stdDev(), savedNormalizer.stdDev());
+  assertEqual(restoredNormalizer.nSamples(), savedNormalizer.nSamples());
+  assertEqual(restoredScaler.minValue(), savedScaler.minValue());
+  assertEqual(restoredScaler.maxValue(), savedScaler.maxValue());
+  assertNear(restoredWave.get(), savedWave.get(), 0.0001f);
+  assertTrue(restoredWave.isRunning());
+  assertNear(restoredRamp.get(), savedRamp.get(), 0.0001f);
+  assertTrue(restoredRamp.isRunning());
+
+  // Truncated state.
+  BufferStateReader truncatedReader(buffer, writer.size() - 1);
+  assertFalse(engineRestored.loadState(truncatedReader));
+
+  // State does not match units.
+  BufferStateReader otherReader(buffer, writer.size());
+  assertFalse(engineGraph.loadState(otherReader));
+
+  // Buffer too small.
+  BufferStateWriter smallWriter(buffer, 16);
+  assertFalse(engineSaved.saveState(smallWriter));
+}
+
+#if PQ_HAS_THREADS
+#define N_EXECUTOR_ENGINES 8
+
+Engine executorEngines[N_EXECUTOR_ENGINES];
+Metronome* executorMetros[N_EXECUTOR_ENGINES];
+unsigned long executorBangs[N_EXECUTOR_ENGINES];
+unsigned long executorSteps[N_EXECUTOR_ENGINES];
+
+void executorCallback(Engine& engine) {
+  int i = &engine - executorEngines;
+  executorSteps[i]++;
+  if (*executorMetros[i])
+    executorBangs[i]++;
+}
+
+test(executor) {
+  EngineExecutor executor(3);
+  assertEqual(executor.nThreads(), (size_t)3);
+
+  for (int i=0; i<N_EXECUTOR_ENGINES; i++) {
+    executorEngines[i].virtualClock(100 * (i+1));
+    executorMetros[i] = new Metronome(0.1f / (i+1), executorEngines[i]); // period = 10 steps
+    executor.add(executorEngines[i], executorCallback);
+  }
+  assertEqual(executor.nEngines(), (size_t)N_EXECUTOR_ENGINES);
+
+  executor.begin();
+  executor.step(); // first step (post-begin)
+  for (int k=0; k<1000; k++)
+    assertEqual(executor.step(), (size_t)N_EXECUTOR_ENGINES);
+
+  // Each engine has run on its own clock.
+  for (int i=0; i<N_EXECUTOR_ENGINES; i++) {
+    assertEqual(executorSteps[i], 1000UL);
+    assertNear(executorBangs[i], 100UL, 1UL);
+    assertEqual(executorEngines[i].nSteps(), 999UL);
+    assertNear(executorEngines[i].microSeconds(), (uint64_t)(1e7 / (i+1)), (uint64_t)1);
+  }
+
+  // Safe shutdown: remaining steps run on calling thread.
+  executor.end();
+  assertEqual(executor.nThreads(), (size_t)0);
+  assertEqual(executor.step(), (size_t)N_EXECUTOR_ENGINES);
+
+  // More workers than engines: only workers with engines take part in rounds.
+  EngineExecutor largeExecutor(4);
+  assertEqual(largeExecutor.step(), (size_t)0);
+  Engine singleEngine;
+  singleEngine.virtualClock(100);
+  largeExecutor.add(singleEngine);
+  largeExecutor.begin();
+  largeExecutor.step();
+  for (int k=0; k<10; k++)
+    assertEqual(largeExecutor.step(), (size_t)1);
+  assertEqual(singleEngine.nSteps(), 9UL);
+}
+#endif
+
 void setup() {
   Plaquette.begin();
   engine1.begin();
@@ -43,6 +43,19 @@ test(removeAll) {
   }
 }
 
+test(truncate) {
+  HybridArrayList<int, INITIAL_CAPACITY> hybridArray;
+  initializeHybridArray(hybridArray);
+
+  hybridArray.truncate(INITIAL_SIZE + 1);
+  assertEqual(hybridArray.size(), (size_t)INITIAL_SIZE);
+
+  hybridArray.truncate(INITIAL_CAPACITY - 1);
+  assertEqual(hybridArray.size(), (size_t)(INITIAL_CAPACITY - 1));
+  for (int i=0; i<INITIAL_CAPACITY - 1; i++) {
+    assertEqual(hybridArray[i], i);
+  }
+}
 
 test(removeInsert) {
   for (int removeItem = 0; removeItem < INITIAL_SIZE; removeItem++) {
@@ -68,6 +81,40 @@ test(removeInsert) {
   }
 }
 
+test(insertFull) {
+  // Insert at each position of a full static array.
+  for (int index = 0; index <= INITIAL_CAPACITY; index++) {
+    HybridArrayList<int, INITIAL_CAPACITY> hybridArray;
+    initializeHybridArray(hybridArray, INITIAL_CAPACITY);
+
+    hybridArray.insert(index, -1);
+    assertEqual(hybridArray.size(), (size_t)(INITIAL_CAPACITY + 1));
+    for (int i=0; i<INITIAL_CAPACITY + 1; i++) {
+      assertEqual(hybridArray[i], (i < index ? i : i == index ? -1 : i - 1));
+    }
+  }
+}
+
+test(removeIf) {
+  HybridArrayList<int, INITIAL_CAPACITY> hybridArray;
+  initializeHybridArray(hybridArray);
+
+  // Remove odd items, across static and dynamic arrays.
+  assertEqual(hybridArray.removeIf([](const int& item) { return item % 2 == 1; }), (size_t)(INITIAL_SIZE / 2));
+  assertEqual(hybridArray.size(), (size_t)(INITIAL_SIZE / 2));
+  for (int i=0; i<INITIAL_SIZE / 2; i++) {
+    assertEqual(hybridArray[i], 2*i);
+  }
+
+  // Nothing to remove.
+  assertEqual(hybridArray.removeIf([](const int& item) { return item < 0; }), (size_t)0);
+  assertEqual(hybridArray.size(), (size_t)(INITIAL_SIZE / 2));
+
+  // Remove everything.
+  assertEqual(hybridArray.removeIf([](const int&) { return true; }), (size_t)(INITIAL_SIZE / 2));
+  assertEqual(hybridArray.size(), (size_t)0);
+}
+
 void setup() {
   Plaquette.begin();
 }